@@ -0,0 +1,158 @@
+/**
+ * bridge-bench: microbenchmarks for the llama-cpp-bridge protocol hot paths
+ *
+ * Covers JSON string escaping, INFER argument parsing and response building
+ * on payloads shaped like real traffic. Needs neither llama.cpp nor a socket:
+ *
+ *   make bench
+ *
+ * escape_json is also checked against the original one-byte-at-a-time
+ * ostringstream encoder, which is timed alongside as a baseline.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bridge-protocol.h"
+
+// ---------------------------------------------------------------------------
+// Harness
+// ---------------------------------------------------------------------------
+static volatile size_t g_sink;
+
+// Runs fn repeatedly for ~0.3 s and prints time per call and throughput
+template <typename Fn>
+static void bench(const char* name, size_t bytes, Fn fn) {
+    using clock = std::chrono::steady_clock;
+    for (int i = 0; i < 16; i++) g_sink = g_sink + fn();  // warm up
+
+    size_t iters = 0;
+    auto   start = clock::now();
+    double secs  = 0;
+    do {
+        for (int i = 0; i < 64; i++) g_sink = g_sink + fn();
+        iters += 64;
+        secs = std::chrono::duration<double>(clock::now() - start).count();
+    } while (secs < 0.3);
+
+    double ns = secs * 1e9 / iters;
+    std::printf("%-34s %10.1f ns/op %9.1f MB/s\n", name, ns, bytes / ns * 1e3);
+}
+
+// The encoder this bridge used before JsonWriter
+static std::string escape_json_reference(const std::string& s) {
+    std::ostringstream o;
+    for (unsigned char c : s) {
+        if      (c == '"')  { o << "\\\""; }
+        else if (c == '\\') { o << "\\\\"; }
+        else if (c == '\n') { o << "\\n";  }
+        else if (c == '\r') { o << "\\r";  }
+        else if (c == '\t') { o << "\\t";  }
+        else if (c < 32)    { o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c; }
+        else                { o << (char)c; }
+    }
+    return o.str();
+}
+
+// ---------------------------------------------------------------------------
+// Payloads
+// ---------------------------------------------------------------------------
+
+// Model output: mostly prose with paragraph breaks and some UTF-8
+static std::string make_prose(size_t n) {
+    static const char* words[] = {
+        "the ", "model ", "answered ", "quickly, ", "and ", "then ", "explained ",
+        "why ", "caf\xc3\xa9 ", "na\xc3\xafve ", "inference ", "matters. ", "\n\n",
+    };
+    std::string s;
+    for (size_t i = 0; s.size() < n; i++) s += words[(i * 7 + i / 3) % 13];
+    s.resize(n);
+    return s;
+}
+
+// Model output that is code: quotes, backslashes and indentation everywhere
+static std::string make_code(size_t n) {
+    static const char* lines[] = {
+        "    printf(\"%s\\n\", name);\n",
+        "\tif (path[i] == '\\\\') continue;\n",
+        "    return {\"status\": \"ok\"};\n",
+        "}\n",
+    };
+    std::string s;
+    for (size_t i = 0; s.size() < n; i++) s += lines[i % 4];
+    s.resize(n);
+    return s;
+}
+
+static bool check(const char* what, const std::string& got, const std::string& want) {
+    if (got == want) return true;
+    std::printf("MISMATCH in %s\n", what);
+    return false;
+}
+
+int main() {
+    const std::string prose_small = make_prose(256);
+    const std::string prose_4k    = make_prose(4 * 1024);
+    const std::string prose_64k   = make_prose(64 * 1024);
+    const std::string code_4k     = make_code(4 * 1024);
+    std::string ctl_1k;  // all control characters plus a few printable ones
+    for (int i = 0; i < 1024; i++) ctl_1k += (char)(i % 40);
+
+    bool ok = true;
+    const std::vector<const std::string*> samples = {&prose_small, &prose_4k, &prose_64k,
+                                                      &code_4k, &ctl_1k};
+    for (const std::string* s : samples)
+        ok &= check("escape_json", escape_json(*s), escape_json_reference(*s));
+    for (size_t len = 0; len < 80; len++) {  // every tail length around the vector width
+        std::string s = make_code(len);
+        ok &= check("escape_json tail", escape_json(s), escape_json_reference(s));
+    }
+    if (!ok) return 1;
+
+    std::printf("-- escape_json\n");
+    bench("reference  prose 4 KiB", prose_4k.size(),
+          [&] { return escape_json_reference(prose_4k).size(); });
+    bench("escape_json prose 256 B", prose_small.size(),
+          [&] { return escape_json(prose_small).size(); });
+    bench("escape_json prose 4 KiB", prose_4k.size(),
+          [&] { return escape_json(prose_4k).size(); });
+    bench("escape_json prose 64 KiB", prose_64k.size(),
+          [&] { return escape_json(prose_64k).size(); });
+    bench("reference  code 4 KiB", code_4k.size(),
+          [&] { return escape_json_reference(code_4k).size(); });
+    bench("escape_json code 4 KiB", code_4k.size(),
+          [&] { return escape_json(code_4k).size(); });
+
+    std::printf("-- parse_infer_args\n");
+    const std::string plain   = "What is the capital of France?";
+    const std::string params  = "max_tokens=512 temperature=0.7 top_p=0.95 seed=42 "
+                                "stop=\\n\\nUser:,</s> priority=batch lora=chat:0.8 " + prose_4k;
+    const std::string spoofed = "x=1 is not a parameter " + prose_small;
+    bench("short prompt, no params", plain.size(),
+          [&] { return parse_infer_args(plain).second.size(); });
+    bench("7 params + 4 KiB prompt", params.size(),
+          [&] { return parse_infer_args(params).second.size(); });
+    bench("prompt starting with key=value", spoofed.size(),
+          [&] { return parse_infer_args(spoofed).second.size(); });
+
+    std::printf("-- responses\n");
+    bench("build_response 4 KiB", prose_4k.size(),
+          [&] { return build_response("ok", "Inference completed", prose_4k).size(); });
+    bench("build_response 64 KiB", prose_64k.size(),
+          [&] { return build_response("ok", "Inference completed", prose_64k).size(); });
+    bench("build_stream_token", 6,
+          [&] { return build_stream_token(" world").size(); });
+
+    std::vector<std::string> results(8, prose_4k);
+    results[3] = code_4k;
+    bench("INFER_MULTI array 8 x 4 KiB", 8 * prose_4k.size(), [&] {
+        return build_response_json("ok", "Multi-inference completed",
+                                   build_string_array(results)).size();
+    });
+
+    return 0;
+}
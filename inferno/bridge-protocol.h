@@ -0,0 +1,347 @@
+/**
+ * bridge-protocol.h: request parsing and JSON response encoding for llama-cpp-bridge
+ *
+ * Everything here is independent of llama.cpp and sockets so the per-request
+ * hot paths can be benchmarked on their own (bridge-bench.cpp, `make bench`).
+ * Responses are built into a single preallocated std::string; JSON string
+ * escaping skips over runs of plain bytes 16 or 32 at a time with SSE2/AVX2
+ * or NEON and copies them in bulk.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Same value as LLAMA_DEFAULT_SEED ("pick a random seed")
+constexpr uint32_t BRIDGE_DEFAULT_SEED = 0xFFFFFFFF;
+
+// Per-request inference parameters
+struct InferParams {
+    int      max_tokens  = 256;
+    float    temperature = 0.8f;
+    float    top_p       = 0.9f;
+    uint32_t seed        = BRIDGE_DEFAULT_SEED;
+    bool     use_cache   = true;  // cache=0 bypasses the response cache
+    bool     trace       = false; // trace=1 records spans for this request
+    std::vector<std::string> stop;    // generation halts when any of these appears
+    bool     ctx_shift   = false; // ctx_shift=1 slides the KV cache instead of failing at n_ctx
+    int      keep        = 1;     // tokens pinned at the start of the context when shifting
+    bool     batch       = false; // priority=batch yields to interactive requests
+    std::vector<std::pair<std::string, float>> lora;  // adapters applied for this request
+};
+
+// How a generation ended, reported next to its text
+struct InferStats {
+    int  n_shifts  = 0;      // context shifts performed (ctx_shift=1)
+    bool truncated = false;  // stopped before EOG/stop/max_tokens, e.g. the context filled up
+};
+
+// ---------------------------------------------------------------------------
+// JSON encoding
+// ---------------------------------------------------------------------------
+inline bool json_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Index of the first byte in s[i, n) that must be escaped, or n
+inline size_t json_scan(const char* s, size_t i, size_t n) {
+#if defined(__AVX2__)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i slash = _mm256_set1_epi8('\\');
+    const __m256i ctl   = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+        // v <= 0x1F (unsigned) exactly when min(v, 0x1F) == v
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+        if (bits) return i + __builtin_ctz(bits);
+    }
+#elif defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctl   = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v));
+        int bits = _mm_movemask_epi8(m);
+        if (bits) return i + __builtin_ctz(bits);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t slash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)s + i);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, slash)),
+                                vcltq_u8(v, space));
+        if (vmaxvq_u8(m)) break;  // the scalar loop finds it within 16 bytes
+    }
+#endif
+    for (; i < n; i++)
+        if (json_needs_escape((unsigned char)s[i])) return i;
+    return n;
+}
+
+// Appends JSON into one growing buffer; reserve up front for the common case
+class JsonWriter {
+public:
+    explicit JsonWriter(size_t reserve = 256) { buf_.reserve(reserve); }
+
+    JsonWriter& raw(std::string_view s) { buf_.append(s); return *this; }
+    JsonWriter& raw(char c)             { buf_ += c; return *this; }
+    JsonWriter& num(long long v)        { buf_ += std::to_string(v); return *this; }
+
+    // Quoted, escaped string
+    JsonWriter& str(std::string_view s) {
+        buf_ += '"';
+        escape(s);
+        buf_ += '"';
+        return *this;
+    }
+
+    // Escaped string contents without the quotes
+    JsonWriter& escape(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        buf_.reserve(buf_.size() + s.size() + 16);
+        const char* p = s.data();
+        size_t      n = s.size();
+        size_t      i = 0;
+        while (i < n) {
+            size_t j = json_scan(p, i, n);
+            buf_.append(p + i, j - i);
+            if (j == n) break;
+
+            unsigned char c = (unsigned char)p[j];
+            switch (c) {
+                case '"':  buf_ += "\\\""; break;
+                case '\\': buf_ += "\\\\"; break;
+                case '\n': buf_ += "\\n";  break;
+                case '\r': buf_ += "\\r";  break;
+                case '\t': buf_ += "\\t";  break;
+                default: {
+                    char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                    buf_.append(u, sizeof(u));
+                }
+            }
+            i = j + 1;
+        }
+        return *this;
+    }
+
+    const std::string& view() const { return buf_; }
+    std::string take() { return std::move(buf_); }
+
+private:
+    std::string buf_;
+};
+
+inline std::string escape_json(std::string_view s) {
+    JsonWriter w(s.size() + 16);
+    w.escape(s);
+    return w.take();
+}
+
+// ["s0","s1",...]: a JSON array of escaped strings, e.g. INFER_MULTI's data
+inline std::string build_string_array(const std::vector<std::string>& items) {
+    size_t reserve = 2;
+    for (const std::string& s : items) reserve += s.size() + 3;
+    JsonWriter w(reserve + reserve / 8);
+    w.raw('[');
+    for (size_t i = 0; i < items.size(); i++) {
+        if (i) w.raw(',');
+        w.str(items[i]);
+    }
+    w.raw(']');
+    return w.take();
+}
+
+// ,"context_shifts":N and ,"truncated":true, each omitted when zero/false
+inline void write_infer_stats(JsonWriter& w, const InferStats& stats) {
+    if (stats.n_shifts > 0) w.raw(",\"context_shifts\":").num(stats.n_shifts);
+    if (stats.truncated)    w.raw(",\"truncated\":true");
+}
+
+// Per-prompt arrays of the same fields, each omitted when no prompt has it
+inline void write_infer_stats(JsonWriter& w, const std::vector<InferStats>& stats) {
+    bool shifted = false, truncated = false;
+    for (const InferStats& s : stats) {
+        shifted   |= s.n_shifts > 0;
+        truncated |= s.truncated;
+    }
+    if (shifted) {
+        w.raw(",\"context_shifts\":[");
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (i) w.raw(',');
+            w.num(stats[i].n_shifts);
+        }
+        w.raw(']');
+    }
+    if (truncated) {
+        w.raw(",\"truncated\":[");
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (i) w.raw(',');
+            w.raw(stats[i].truncated ? "true" : "false");
+        }
+        w.raw(']');
+    }
+}
+
+// {"status":...,"message":...[,"data":...][,"context_shifts":N][,"truncated":true]}\n,
+// with data as a JSON string; data is omitted when empty
+inline std::string build_response(std::string_view status, std::string_view message,
+                                  std::string_view data = {}, const InferStats& stats = {}) {
+    JsonWriter w(80 + message.size() + data.size());
+    w.raw("{\"status\":").str(status).raw(",\"message\":").str(message);
+    if (!data.empty()) w.raw(",\"data\":").str(data);
+    write_infer_stats(w, stats);
+    w.raw("}\n");
+    return w.take();
+}
+
+// As build_response, but data_json is already-encoded JSON emitted verbatim;
+// stats, if given, holds one entry per element of a multi-prompt result
+inline std::string build_response_json(std::string_view status, std::string_view message,
+                                       std::string_view data_json,
+                                       const std::vector<InferStats>& stats = {}) {
+    JsonWriter w(80 + message.size() + data_json.size() + 8 * stats.size());
+    w.raw("{\"status\":").str(status).raw(",\"message\":").str(message);
+    w.raw(",\"data\":").raw(data_json);
+    write_infer_stats(w, stats);
+    w.raw("}\n");
+    return w.take();
+}
+
+inline std::string build_stream_token(std::string_view token, bool is_final = false,
+                                      const InferStats& stats = {}) {
+    JsonWriter w(64 + token.size());
+    w.raw("{\"type\":\"token\",\"token\":").str(token);
+    if (is_final) w.raw(",\"final\":true");
+    write_infer_stats(w, stats);
+    w.raw("}\n");
+    return w.take();
+}
+
+// ---------------------------------------------------------------------------
+// Inference parameter parsing
+// Syntax (all optional before the prompt):
+//   [max_tokens=N] [temperature=T] [top_p=P] [seed=S] [cache=0|1] [trace=0|1]
+//   [stop=S1,S2,...] [ctx_shift=0|1] [keep=K] [priority=interactive|batch]
+//   [lora=NAME[:SCALE],...] <prompt text>
+// stop= may be repeated. Inside a stop value the escapes \n, \t, \r, \s (space),
+// \, (comma) and a doubled backslash let stop strings contain those characters.
+// ---------------------------------------------------------------------------
+inline void parse_lora_list(const std::string& val,
+                            std::vector<std::pair<std::string, float>>& out) {
+    size_t pos = 0;
+    while (pos <= val.size()) {
+        size_t comma = val.find(',', pos);
+        if (comma == std::string::npos) comma = val.size();
+        std::string item = val.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (item.empty()) continue;
+
+        size_t colon = item.find(':');
+        float scale = 1.0f;
+        if (colon != std::string::npos) {
+            try { scale = std::stof(item.substr(colon + 1)); } catch (...) {}
+            item.resize(colon);
+        }
+        out.emplace_back(item, scale);
+    }
+}
+
+inline void parse_stop_list(const std::string& val, std::vector<std::string>& out) {
+    std::string cur;
+    for (size_t i = 0; i < val.size(); i++) {
+        char c = val[i];
+        if (c == ',') {
+            if (!cur.empty()) out.push_back(cur);
+            cur.clear();
+        } else if (c == '\\' && i + 1 < val.size()) {
+            char e = val[++i];
+            if      (e == 'n') cur += '\n';
+            else if (e == 't') cur += '\t';
+            else if (e == 'r') cur += '\r';
+            else if (e == 's') cur += ' ';
+            else               cur += e;
+        } else {
+            cur += c;
+        }
+    }
+    if (!cur.empty()) out.push_back(cur);
+}
+
+inline std::string_view trim_left(std::string_view s) {
+    size_t p = s.find_first_not_of(" \t");
+    return (p == std::string_view::npos) ? std::string_view() : s.substr(p);
+}
+
+// Splits off the first space-delimited word of s and advances s past it
+inline std::string_view next_word(std::string_view& s) {
+    s = trim_left(s);
+    size_t sp = s.find_first_of(" \t");
+    std::string_view word = s.substr(0, sp);
+    s = (sp == std::string_view::npos) ? std::string_view() : s.substr(sp + 1);
+    return word;
+}
+
+// The prompt is returned as a view into args; nothing is copied
+inline std::pair<InferParams, std::string_view> parse_infer_args(std::string_view args) {
+    InferParams params;
+    std::string_view rem = trim_left(args);
+
+    // Consume keyword=value tokens
+    while (!rem.empty()) {
+        size_t eq = rem.find('=');
+        size_t sp = rem.find(' ');
+        // If '=' doesn't exist or comes after a space, we're at the prompt
+        if (eq == std::string_view::npos || (sp != std::string_view::npos && sp < eq)) break;
+
+        std::string_view key = rem.substr(0, eq);
+
+        // Validate key BEFORE consuming the prefix from rem.
+        // If unknown, leave rem untouched so the prompt (e.g. "x=hello world")
+        // is preserved verbatim for the inference call.
+        if (key != "max_tokens" && key != "temperature" && key != "top_p" &&
+            key != "seed" && key != "cache" && key != "trace" && key != "stop" &&
+            key != "ctx_shift" && key != "keep" && key != "priority" && key != "lora")
+            break;
+
+        std::string_view after_eq = rem.substr(eq + 1);
+        sp = after_eq.find(' ');
+        std::string_view view = after_eq.substr(0, sp);
+        std::string      val(view);
+
+        if      (key == "max_tokens")  { try { params.max_tokens  = std::stoi(val); } catch (...) {} }
+        else if (key == "temperature") { try { params.temperature = std::stof(val); } catch (...) {} }
+        else if (key == "top_p")       { try { params.top_p       = std::stof(val); } catch (...) {} }
+        else if (key == "seed")        { try { params.seed        = (uint32_t)std::stoul(val); } catch (...) {} }
+        else if (key == "cache")       { params.use_cache = (val != "0"); }
+        else if (key == "trace")       { params.trace     = (val != "0"); }
+        else if (key == "stop")        { parse_stop_list(val, params.stop); }
+        else if (key == "ctx_shift")   { params.ctx_shift = (val != "0"); }
+        else if (key == "keep")        { try { params.keep        = std::stoi(val); } catch (...) {} }
+        else if (key == "priority")    { params.batch     = (val == "batch"); }
+        else if (key == "lora")        { parse_lora_list(val, params.lora); }
+
+        rem = (sp == std::string_view::npos) ? std::string_view() : trim_left(after_eq.substr(sp + 1));
+    }
+
+    return {params, rem};
+}
@@ -12,18 +12,79 @@
  *   PING
  *   STATUS
  *   LOAD <model_path>
- *   INFER [max_tokens=N] [temperature=T] [top_p=P] <prompt>
- *   INFER_STREAM [max_tokens=N] [temperature=T] [top_p=P] <prompt>
- *   INFER_MULTI [max_tokens=N] [temperature=T] [top_p=P] <prompt1>||<prompt2>||...
+ *   LOAD_LORA <name> <adapter_path>
+ *   UNLOAD_LORA <name>
+ *   INFER [params] <prompt>
+ *   INFER_STREAM [params] <prompt>
+ *   INFER_MULTI [params] <prompt1>||<prompt2>||...
+ *   INFER_BODY <nbytes> [params]          (followed by exactly nbytes of prompt)
+ *   INFER_STREAM_BODY <nbytes> [params]   (followed by exactly nbytes of prompt)
+ *   TRACE on|off|clear|dump [file]
  *   FREE
  *   QUIT
+ *
+ * Inference params (all optional, before the prompt):
+ *   max_tokens=N temperature=T top_p=P seed=S cache=0|1 trace=0|1
+ *   stop=S1,S2 ctx_shift=0|1 keep=K priority=interactive|batch
+ *   lora=NAME[:SCALE][,NAME[:SCALE]...]
+ *
+ * Response cache:
+ *   Started with --cache-bytes N, the bridge memoises results of deterministic
+ *   requests (temperature=0 or an explicit seed=S) keyed by model, prompt tokens
+ *   and sampling parameters. cache=0 bypasses it for a single request.
+ *
+ * Stop sequences:
+ *   Generation halts as soon as any stop string appears in the output; the
+ *   stop string itself is not returned. Streamed tokens never split a UTF-8
+ *   codepoint or leak the start of a stop string that later matches.
+ *
+ * Context shift:
+ *   ctx_shift=1 keeps generating past n_ctx by pinning the first keep=K tokens
+ *   and discarding the oldest half of the rest from the KV cache. The number
+ *   of shifts is returned as "context_shifts" on INFER responses (one entry per
+ *   prompt for INFER_MULTI) and on the final stream token, cache hits included.
+ *   Generation that stops early (e.g. n_ctx reached without ctx_shift) keeps
+ *   status "ok" with the partial text and adds "truncated":true.
+ *
+ * Tracing:
+ *   trace=1 on an INFER* command (or TRACE on for every request) records
+ *   nanosecond spans into a ring buffer; TRACE dump writes them out as
+ *   Chrome/Perfetto trace-event JSON, either inline or to a plain file name
+ *   inside the directory given by --trace-dir.
+ *
+ * LoRA adapters:
+ *   Adapters are loaded once against the resident base model and applied per
+ *   request with lora=NAME[:SCALE]; requests without lora= run the bare model.
+ *
+ * Large prompts:
+ *   The _BODY variants take the prompt as a raw length-prefixed payload, so it
+ *   may contain newlines and needs no escaping. Commands may be pipelined; a
+ *   request line or body larger than --max-request-bytes is rejected.
+ *
+ * Scheduling:
+ *   Each client connection has its own thread; inference, LOAD and FREE are
+ *   serialised through a bounded scheduler. priority=interactive|batch picks
+ *   the class. When the queue or token budget is full the bridge answers
+ *   immediately with {"status":"busy",...,"data":"<estimated wait ms>"}.
  */
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <iomanip>
 #include <memory>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <map>
+#include <sys/stat.h>
 #include <cstring>
 #include <cstdlib>
 #include <unistd.h>
@@ -34,29 +95,374 @@
 
 // Include llama.cpp headers
 #include "../llama.cpp/llama.h"
+#include "bridge-protocol.h"
+#include "stop-sequences.h"
 
 // Default socket path (overridable via --socket-path)
 static const char* DEFAULT_SOCKET_PATH = "/tmp/llama-cpp-bridge.sock";
-static const int   MAX_CONNECTIONS     = 10;
+static const int   MAX_CONNECTIONS     = 10;   // listen backlog
+static const int   N_BATCH             = 512;
+static const int   SHUTDOWN_GRACE_SECONDS = 5;  // for clients to read their last replies
 
 // Per-inference configurable parameters with defaults
-struct InferParams {
-    int   max_tokens  = 256;
-    float temperature = 0.8f;
-    float top_p       = 0.9f;
-};
+static_assert(LLAMA_DEFAULT_SEED == BRIDGE_DEFAULT_SEED, "InferParams seed default out of sync");
+
+// Output is reproducible only with greedy decoding or a caller-fixed seed
+static bool is_deterministic(const InferParams& p) {
+    return p.temperature <= 0.0f || p.seed != LLAMA_DEFAULT_SEED;
+}
 
 // Bridge global state
+// A LoRA adapter loaded against the current base model
+struct LoraAdapter {
+    llama_lora_adapter* adapter = nullptr;
+    std::string         path;
+    uint64_t            bytes   = 0;   // adapter file size, reported by STATUS
+};
+
 struct BridgeState {
     llama_model*  model       = nullptr;
     llama_context* ctx        = nullptr;
     std::string   model_path;
-    bool          running     = true;
+    std::map<std::string, LoraAdapter> loras;
+    std::string   applied_lora;           // adapter set currently attached to ctx
+    std::mutex    mutex;                  // guards model/model_path for STATUS readers
+    std::atomic<bool> running{true};
     const char*   socket_path = DEFAULT_SOCKET_PATH;
+    int           srv_fd      = -1;
+    size_t        max_clients = 64;
+    size_t        max_request_bytes = 16u << 20;  // longest command line or body
 };
 
 static BridgeState g_state;
 
+// ---------------------------------------------------------------------------
+// Deterministic response cache
+// LRU of generated token pieces, bounded by max_bytes and expired after ttl.
+// Disabled (max_bytes == 0) unless --cache-bytes is given.
+// ---------------------------------------------------------------------------
+struct CacheEntry {
+    std::string                           key;
+    std::vector<std::string>              pieces;
+    size_t                                bytes = 0;
+    std::chrono::steady_clock::time_point created;
+    int                                   n_shifts = 0;  // context shifts the answer needed
+};
+
+struct ResponseCache {
+    std::mutex mutex;
+    size_t   max_bytes   = 0;
+    int      ttl_seconds = 3600;
+    size_t   bytes       = 0;
+    uint64_t hits        = 0;
+    uint64_t misses      = 0;
+    uint64_t evictions   = 0;
+
+    // front = most recently used. Index keys view CacheEntry::key, so each key
+    // is held once; list nodes never move, which keeps the views valid.
+    std::list<CacheEntry> lru;
+    std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> index;
+};
+
+static ResponseCache g_cache;
+
+// Key material: model identity, sampling parameters and raw prompt tokens.
+// The full key is stored so hash collisions can never return a wrong answer.
+static std::string make_cache_key(const std::vector<llama_token>& toks,
+                                  const InferParams& p) {
+    std::string key = g_state.model_path;
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char*>(&p.max_tokens),  sizeof(p.max_tokens));
+    key.append(reinterpret_cast<const char*>(&p.temperature), sizeof(p.temperature));
+    key.append(reinterpret_cast<const char*>(&p.top_p),       sizeof(p.top_p));
+    key.append(reinterpret_cast<const char*>(&p.seed),        sizeof(p.seed));
+    key.append(reinterpret_cast<const char*>(&p.ctx_shift),   sizeof(p.ctx_shift));
+    key.append(reinterpret_cast<const char*>(&p.keep),        sizeof(p.keep));
+    for (const auto& s : p.stop) { key += s; key.push_back('\0'); }
+    key.push_back('\0');
+    for (const auto& l : p.lora) {
+        key += l.first;
+        key.append(reinterpret_cast<const char*>(&l.second), sizeof(l.second));
+    }
+    key.append(reinterpret_cast<const char*>(toks.data()), toks.size() * sizeof(llama_token));
+    return key;
+}
+
+static bool cache_enabled_for(const InferParams& p) {
+    return g_cache.max_bytes > 0 && p.use_cache && is_deterministic(p);
+}
+
+static void cache_erase(std::list<CacheEntry>::iterator it) {
+    g_cache.bytes -= it->bytes;
+    g_cache.index.erase(it->key);
+    g_cache.lru.erase(it);
+}
+
+static void cache_clear() {
+    std::lock_guard<std::mutex> lock(g_cache.mutex);
+    g_cache.lru.clear();
+    g_cache.index.clear();
+    g_cache.bytes = 0;
+}
+
+static bool cache_lookup(const std::string& key, std::vector<std::string>& pieces,
+                         int& n_shifts) {
+    std::lock_guard<std::mutex> lock(g_cache.mutex);
+    auto found = g_cache.index.find(key);
+    if (found == g_cache.index.end()) { ++g_cache.misses; return false; }
+
+    auto it  = found->second;
+    auto age = std::chrono::steady_clock::now() - it->created;
+    if (age > std::chrono::seconds(g_cache.ttl_seconds)) {
+        cache_erase(it);
+        ++g_cache.misses;
+        return false;
+    }
+
+    g_cache.lru.splice(g_cache.lru.begin(), g_cache.lru, it);
+    ++g_cache.hits;
+    pieces   = it->pieces;
+    n_shifts = it->n_shifts;
+    return true;
+}
+
+static void cache_insert(const std::string& key, std::vector<std::string> pieces, int n_shifts) {
+    std::lock_guard<std::mutex> lock(g_cache.mutex);
+    size_t bytes = key.size() + sizeof(CacheEntry);
+    for (const auto& s : pieces) bytes += s.size() + sizeof(std::string);
+    if (bytes > g_cache.max_bytes) return;
+
+    auto found = g_cache.index.find(key);
+    if (found != g_cache.index.end()) cache_erase(found->second);
+
+    while (g_cache.bytes + bytes > g_cache.max_bytes && !g_cache.lru.empty()) {
+        cache_erase(std::prev(g_cache.lru.end()));
+        ++g_cache.evictions;
+    }
+
+    g_cache.lru.push_front({key, std::move(pieces), bytes, std::chrono::steady_clock::now(), n_shifts});
+    g_cache.index[g_cache.lru.front().key] = g_cache.lru.begin();
+    g_cache.bytes += bytes;
+}
+
+// ---------------------------------------------------------------------------
+// Request tracing
+// Fixed-size ring of completed spans; the oldest spans are overwritten, so it
+// is cheap to leave enabled. Each request is its own track (tid) in the dump.
+// ---------------------------------------------------------------------------
+struct TraceEvent {
+    const char* name;
+    uint64_t    start_ns;
+    uint64_t    dur_ns;
+    uint64_t    request_id;
+};
+
+struct TraceRing {
+    std::mutex              mutex;
+    std::vector<TraceEvent> events;
+    size_t                  capacity = 65536;
+    size_t                  head     = 0;     // next slot to write
+    size_t                  count    = 0;
+    std::atomic<bool>       enabled{false};   // TRACE on
+    std::string             dir;              // --trace-dir; empty disables file dumps
+    std::atomic<uint64_t>   next_request_id{0};
+};
+
+static TraceRing g_trace;
+
+// Per client thread: trace=1 on the command being handled, and its track id
+static thread_local bool     t_trace_active = false;
+static thread_local uint64_t t_request_id   = 0;
+
+static uint64_t trace_now_ns() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+static void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    if (!g_trace.enabled && !t_trace_active) return;
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    if (g_trace.events.size() != g_trace.capacity) {
+        g_trace.events.assign(g_trace.capacity, TraceEvent{});
+        g_trace.head = g_trace.count = 0;
+    }
+    g_trace.events[g_trace.head] = {name, start_ns, end_ns - start_ns, t_request_id};
+    g_trace.head = (g_trace.head + 1) % g_trace.capacity;
+    if (g_trace.count < g_trace.capacity) ++g_trace.count;
+}
+
+// RAII span; the start time is always taken, recording is decided at scope exit
+struct TraceSpan {
+    const char* name;
+    uint64_t    start_ns;
+    explicit TraceSpan(const char* n) : name(n), start_ns(trace_now_ns()) {}
+    ~TraceSpan() { trace_record(name, start_ns, trace_now_ns()); }
+};
+
+// Scopes one command: assigns a request id and, on exit, records the time the
+// line waited between recv and dispatch before clearing the trace=1 flag
+struct TraceRequest {
+    uint64_t recv_ns;
+    uint64_t dispatch_ns;
+    explicit TraceRequest(uint64_t r) : recv_ns(r), dispatch_ns(trace_now_ns()) {
+        t_request_id = ++g_trace.next_request_id;
+    }
+    ~TraceRequest() {
+        trace_record("recv", recv_ns, dispatch_ns);
+        t_trace_active = false;
+    }
+};
+
+// n_events, if given, receives the number of events in this snapshot
+static std::string trace_to_json(size_t* n_events = nullptr) {
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    if (n_events) *n_events = g_trace.count;
+    std::ostringstream o;
+    o << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    size_t first = (g_trace.head + g_trace.capacity - g_trace.count) % g_trace.capacity;
+    for (size_t i = 0; i < g_trace.count; i++) {
+        const TraceEvent& e = g_trace.events[(first + i) % g_trace.capacity];
+        if (i) o << ",";
+        o << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1"
+          << ",\"tid\":" << e.request_id
+          << std::fixed << std::setprecision(3)
+          << ",\"ts\":"  << e.start_ns / 1000.0
+          << ",\"dur\":" << e.dur_ns / 1000.0 << "}";
+    }
+    o << "]}";
+    return o.str();
+}
+
+// ---------------------------------------------------------------------------
+// Request scheduler
+// A single llama_context serves every client, so jobs run one at a time.
+// Waiting jobs are ordered by priority class (interactive before batch) and,
+// within a class, by the tokens each client has already been served, so one
+// chatty client cannot monopolise the engine. Admission is bounded by queue
+// length and by a budget of estimated tokens (prompt + max_tokens); batch
+// jobs may only fill 3/4 of the queue slots and of that budget, leaving
+// headroom for interactive.
+// ---------------------------------------------------------------------------
+struct Job {
+    uint64_t seq;
+    uint64_t client_id;
+    bool     batch;
+    uint64_t cost;
+};
+
+struct Scheduler {
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::list<Job>          queue;
+    bool                    engine_busy   = false;
+    uint64_t                running_cost  = 0;
+    uint64_t                queued_tokens = 0;
+    size_t                  max_queue     = 32;
+    uint64_t                token_budget  = 65536;
+    double                  ms_per_token  = 25.0;  // EWMA of observed service time
+    uint64_t                next_seq      = 0;
+    uint64_t                admitted      = 0;
+    uint64_t                rejected      = 0;
+    std::unordered_map<uint64_t, uint64_t> served_tokens;  // fair-share ledger per client
+};
+
+static Scheduler g_sched;
+
+// Prompt tokens are estimated at ~4 bytes each so admission never has to
+// touch the model outside the engine slot
+static uint64_t estimate_cost(std::string_view prompt, const InferParams& p) {
+    return prompt.size() / 4 + 1 + (uint64_t)std::max(p.max_tokens, 0);
+}
+
+static uint64_t estimate_wait_ms_locked() {
+    return (uint64_t)((g_sched.queued_tokens + g_sched.running_cost) * g_sched.ms_per_token);
+}
+
+// True when some request is queued behind the one holding the engine
+static bool sched_has_waiters() {
+    std::lock_guard<std::mutex> lock(g_sched.mutex);
+    return !g_sched.queue.empty();
+}
+
+static std::list<Job>::iterator next_job_locked() {
+    auto best = g_sched.queue.begin();
+    for (auto it = g_sched.queue.begin(); it != g_sched.queue.end(); ++it) {
+        if (it->batch != best->batch) {
+            if (!it->batch) best = it;
+            continue;
+        }
+        uint64_t served_it   = g_sched.served_tokens[it->client_id];
+        uint64_t served_best = g_sched.served_tokens[best->client_id];
+        if (served_it < served_best) best = it;
+    }
+    return best;
+}
+
+// RAII hold on the inference engine. The constructor either rejects the job
+// at once (admitted() == false) or blocks until the job's turn comes.
+// force=true skips admission control for administrative work (LOAD/FREE).
+struct EngineSlot {
+    uint64_t client_id;
+    uint64_t cost;
+    bool     admitted = false;
+    uint64_t wait_ms  = 0;    // estimated wait reported on rejection
+    size_t   depth    = 0;    // queue depth seen on rejection
+    std::chrono::steady_clock::time_point started;
+
+    EngineSlot(uint64_t client, bool batch, uint64_t c, bool force = false)
+        : client_id(client), cost(c) {
+        TraceSpan span("queue");
+        std::unique_lock<std::mutex> lock(g_sched.mutex);
+
+        bool idle  = g_sched.queue.empty() && !g_sched.engine_busy;
+        size_t   max_queue = batch ? g_sched.max_queue * 3 / 4 : g_sched.max_queue;
+        uint64_t limit     = batch ? g_sched.token_budget / 4 * 3 : g_sched.token_budget;
+        if (!force && !idle &&
+            (g_sched.queue.size() >= max_queue ||
+             g_sched.queued_tokens + cost > limit)) {
+            wait_ms = estimate_wait_ms_locked();
+            depth   = g_sched.queue.size() + (g_sched.engine_busy ? 1 : 0);
+            ++g_sched.rejected;
+            return;
+        }
+
+        uint64_t seq = g_sched.next_seq++;
+        g_sched.queue.push_back({seq, client_id, batch, cost});
+        g_sched.queued_tokens += cost;
+        ++g_sched.admitted;
+
+        g_sched.cv.wait(lock, [&] {
+            return !g_sched.engine_busy && next_job_locked()->seq == seq;
+        });
+        g_sched.queue.erase(next_job_locked());
+        g_sched.queued_tokens -= cost;
+        g_sched.engine_busy   = true;
+        g_sched.running_cost  = cost;
+        admitted = true;
+        started  = std::chrono::steady_clock::now();
+    }
+
+    ~EngineSlot() {
+        if (!admitted) return;
+        std::lock_guard<std::mutex> lock(g_sched.mutex);
+        g_sched.engine_busy  = false;
+        g_sched.running_cost = 0;
+        g_sched.served_tokens[client_id] += cost;
+        if (cost > 0) {
+            double ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - started).count();
+            g_sched.ms_per_token = 0.8 * g_sched.ms_per_token + 0.2 * (ms / cost);
+        }
+        g_sched.cv.notify_all();
+    }
+};
+
+static void sched_forget_client(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(g_sched.mutex);
+    g_sched.served_tokens.erase(client_id);
+}
+
 // ---------------------------------------------------------------------------
 // Signal handling
 // ---------------------------------------------------------------------------
@@ -69,6 +475,10 @@ static void signal_handler(int signum) {
 // Resource cleanup
 // ---------------------------------------------------------------------------
 static void cleanup_model() {
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    // Adapters are owned by their model and released by llama_model_free
+    g_state.loras.clear();
+    g_state.applied_lora.clear();
     if (g_state.ctx != nullptr) {
         llama_free(g_state.ctx);
         g_state.ctx = nullptr;
@@ -78,6 +488,7 @@ static void cleanup_model() {
         g_state.model = nullptr;
     }
     g_state.model_path.clear();
+    cache_clear();
 }
 
 static void cleanup() {
@@ -85,96 +496,249 @@ static void cleanup() {
     llama_backend_free();
 }
 
+static bool write_fd(int fd, const std::string& data) {
+    ssize_t sent = 0;
+    while (sent < (ssize_t)data.size()) {
+        ssize_t n = send(fd, data.c_str() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
 // ---------------------------------------------------------------------------
-// JSON helpers
+// Per-connection output queue
+// The command thread (the only producer) appends response lines to a
+// lock-free SPSC linked queue; a per-connection writer thread drains it,
+// coalescing everything queued into one send(). Generation therefore never
+// blocks on a slow socket. When more than high_water bytes are queued the
+// streaming loop pauses that one sequence while it still holds the engine.
+// It gives up as soon as another request is waiting for the engine, when
+// the reader has not caught up within stall_ms, or when the reader is gone.
+// Each line carries the trace context of the command that produced it so
+// the writer can record "write" spans on that request's track.
 // ---------------------------------------------------------------------------
-static std::string escape_json(const std::string& s) {
-    std::ostringstream o;
-    for (unsigned char c : s) {
-        if      (c == '"')  { o << "\\\""; }
-        else if (c == '\\') { o << "\\\\"; }
-        else if (c == '\n') { o << "\\n";  }
-        else if (c == '\r') { o << "\\r";  }
-        else if (c == '\t') { o << "\\t";  }
-        else if (c < 32)    { o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c; }
-        else                { o << (char)c; }
+struct WriteTag {
+    uint64_t request_id;
+    bool     traced;      // trace=1 was set on the producing command
+};
+
+struct OutputQueue {
+    struct Node {
+        std::string        data;
+        WriteTag           tag{0, false};
+        std::atomic<Node*> next{nullptr};
+    };
+
+    static size_t high_water;  // --out-high-water
+    static int    stall_ms;    // --out-stall-ms
+
+    Node*               head;               // consumer side (stub node)
+    Node*               tail;               // producer side
+    std::atomic<size_t> bytes{0};
+    std::atomic<bool>   closed{false};
+    std::atomic<bool>   broken{false};      // a send() failed; the reader is gone
+    std::atomic<bool>   writer_sleeping{false};
+    std::atomic<bool>   producer_waiting{false};
+    std::mutex              mutex;          // only used to sleep/wake, never on the data path
+    std::condition_variable data_cv;
+    std::condition_variable drain_cv;
+
+    OutputQueue() : head(new Node), tail(head) {}
+    ~OutputQueue() {
+        while (head) { Node* n = head->next.load(); delete head; head = n; }
     }
-    return o.str();
-}
 
-static void send_all(int fd, const std::string& data) {
-    ssize_t sent = 0;
-    while (sent < (ssize_t)data.size()) {
-        ssize_t n = send(fd, data.c_str() + sent, data.size() - sent, 0);
-        if (n <= 0) break;
-        sent += n;
+    void push(std::string data) {
+        if (broken) return;
+        bytes += data.size();
+        Node* n = new Node;
+        n->data = std::move(data);
+        n->tag  = {t_request_id, t_trace_active};
+        tail->next.store(n);  // seq_cst pairs with writer_sleeping below
+        tail = n;
+        if (writer_sleeping) {
+            std::lock_guard<std::mutex> lock(mutex);
+            data_cv.notify_one();
+        }
+    }
+
+    // Consumer: appends every queued line to out and the distinct requests
+    // they belong to to tags; false once closed and empty
+    bool pop_all(std::string& out, std::vector<WriteTag>& tags) {
+        for (;;) {
+            Node* next;
+            while ((next = head->next.load(std::memory_order_acquire)) != nullptr) {
+                out += next->data;
+                if (tags.empty() || tags.back().request_id != next->tag.request_id)
+                    tags.push_back(next->tag);
+                next->data.clear();
+                delete head;
+                head = next;
+            }
+            if (!out.empty()) return true;
+            if (closed) return false;
+
+            writer_sleeping = true;
+            std::unique_lock<std::mutex> lock(mutex);
+            data_cv.wait(lock, [&] { return head->next.load() != nullptr || closed; });
+            writer_sleeping = false;
+        }
+    }
+
+    void drained(size_t n) {
+        bytes -= n;
+        if (producer_waiting) {
+            std::lock_guard<std::mutex> lock(mutex);
+            drain_cv.notify_all();
+        }
+    }
+
+    // Producer, called while holding the engine: returns false if the
+    // sequence should be abandoned. Waiting is only allowed while no other
+    // request is queued for the engine.
+    bool throttle() {
+        if (broken) return false;
+        if (bytes <= high_water) return true;
+
+        TraceSpan span("throttle");
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(stall_ms);
+        producer_waiting = true;
+        bool ok = false;
+        while (!broken && !sched_has_waiters() && std::chrono::steady_clock::now() < deadline) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (drain_cv.wait_for(lock, std::chrono::milliseconds(10),
+                                  [&] { return bytes <= high_water / 2 || broken; })) {
+                ok = !broken;
+                break;
+            }
+        }
+        producer_waiting = false;
+        return ok;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        data_cv.notify_one();
     }
+};
+
+size_t OutputQueue::high_water = 1 << 20;
+int    OutputQueue::stall_ms   = 2000;
+
+struct Connection {
+    int         fd;
+    uint64_t    id;
+    OutputQueue out;
+};
+
+static void writer_loop(Connection* c) {
+    std::string           batch;
+    std::vector<WriteTag> tags;
+    while (c->out.pop_all(batch, tags)) {
+        size_t   n     = batch.size();
+        uint64_t start = trace_now_ns();
+        if (!c->out.broken && !write_fd(c->fd, batch)) c->out.broken = true;
+        uint64_t end = trace_now_ns();
+
+        // A coalesced send is recorded once on every request it carried
+        for (const WriteTag& t : tags) {
+            t_request_id   = t.request_id;
+            t_trace_active = t.traced;
+            trace_record("write", start, end);
+        }
+        batch.clear();
+        tags.clear();
+        c->out.drained(n);
+    }
+}
+
+static void send_all(Connection& c, std::string data) {
+    c.out.push(std::move(data));
+}
+
+static void send_response(Connection& c, std::string_view status,
+                          std::string_view message, std::string_view data = {},
+                          const InferStats& stats = {}) {
+    send_all(c, build_response(status, message, data, stats));
 }
 
-static void send_response(int fd, const std::string& status,
-                           const std::string& message, const std::string& data = "") {
-    std::ostringstream r;
-    r << "{\"status\":\"" << status
-      << "\",\"message\":\"" << escape_json(message) << "\"";
-    if (!data.empty())
-        r << ",\"data\":\"" << escape_json(data) << "\"";
-    r << "}\n";
-    send_all(fd, r.str());
+static void send_stream_token(Connection& c, std::string_view token, bool is_final = false,
+                              const InferStats& stats = {}) {
+    send_all(c, build_stream_token(token, is_final, stats));
 }
 
-static void send_stream_token(int fd, const std::string& token, bool is_final = false) {
-    std::ostringstream r;
-    r << "{\"type\":\"token\",\"token\":\"" << escape_json(token) << "\"";
-    if (is_final) r << ",\"final\":true";
-    r << "}\n";
-    send_all(fd, r.str());
+static void send_busy(Connection& c, const EngineSlot& slot) {
+    send_response(c, "busy", "Bridge saturated (queue depth " + std::to_string(slot.depth) + ")",
+                  std::to_string(slot.wait_ms));
 }
 
 // ---------------------------------------------------------------------------
-// Inference parameter parsing
-// Syntax (all optional before the prompt):
-//   [max_tokens=N] [temperature=T] [top_p=P] <prompt text>
+// LoRA adapters
 // ---------------------------------------------------------------------------
-static std::pair<InferParams, std::string> parse_infer_args(const std::string& args) {
-    InferParams params;
-    std::string rem = args;
-
-    // Trim leading whitespace
-    auto ltrim = [](std::string& s) {
-        size_t p = s.find_first_not_of(" \t");
-        if (p != std::string::npos) s = s.substr(p);
-        else s.clear();
-    };
-    ltrim(rem);
+static bool load_lora(const std::string& name, const std::string& path, std::string& err) {
+    if (!g_state.model) { err = "No model loaded"; return false; }
 
-    // Consume keyword=value tokens
-    while (!rem.empty()) {
-        size_t eq = rem.find('=');
-        size_t sp = rem.find(' ');
-        // If '=' doesn't exist or comes after a space, we're at the prompt
-        if (eq == std::string::npos || (sp != std::string::npos && sp < eq)) break;
+    llama_lora_adapter* adapter = llama_lora_adapter_init(g_state.model, path.c_str());
+    if (!adapter) { err = "Failed to load LoRA adapter: " + path; return false; }
 
-        std::string key = rem.substr(0, eq);
+    struct stat st;
+    uint64_t bytes = (stat(path.c_str(), &st) == 0) ? (uint64_t)st.st_size : 0;
 
-        // Validate key BEFORE consuming the prefix from rem.
-        // If unknown, leave rem untouched so the prompt (e.g. "x=hello world")
-        // is preserved verbatim for the inference call.
-        if (key != "max_tokens" && key != "temperature" && key != "top_p")
-            break;
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    auto it = g_state.loras.find(name);
+    if (it != g_state.loras.end()) {
+        llama_lora_adapter_remove(g_state.ctx, it->second.adapter);
+        llama_lora_adapter_free(it->second.adapter);
+        cache_clear();  // cached lora=name answers came from the old weights
+    }
+    g_state.loras[name] = {adapter, path, bytes};
+    // Detach everything so the context matches applied_lora == "" (no adapters)
+    llama_lora_adapter_clear(g_state.ctx);
+    g_state.applied_lora.clear();
+    return true;
+}
 
-        std::string after_eq = rem.substr(eq + 1);
-        sp = after_eq.find(' ');
-        std::string val = (sp != std::string::npos) ? after_eq.substr(0, sp) : after_eq;
+static bool unload_lora(const std::string& name) {
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    auto it = g_state.loras.find(name);
+    if (it == g_state.loras.end()) return false;
+    llama_lora_adapter_remove(g_state.ctx, it->second.adapter);
+    llama_lora_adapter_free(it->second.adapter);
+    g_state.loras.erase(it);
+    llama_lora_adapter_clear(g_state.ctx);
+    g_state.applied_lora.clear();
+    cache_clear();
+    return true;
+}
 
-        if      (key == "max_tokens")  { try { params.max_tokens  = std::stoi(val); } catch (...) {} }
-        else if (key == "temperature") { try { params.temperature = std::stof(val); } catch (...) {} }
-        else if (key == "top_p")       { try { params.top_p       = std::stof(val); } catch (...) {} }
+// Attach exactly the adapters named in p.lora to the context. The attached
+// set is remembered so consecutive requests for the same adapters skip it.
+static bool apply_lora(const InferParams& p, std::string& err) {
+    std::string want;
+    for (const auto& l : p.lora) want += l.first + ":" + std::to_string(l.second) + ",";
+    if (want == g_state.applied_lora) return true;
 
-        if (sp == std::string::npos) rem.clear();
-        else { rem = after_eq.substr(sp + 1); ltrim(rem); }
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    for (const auto& l : p.lora) {
+        if (!g_state.loras.count(l.first)) { err = "Unknown LoRA adapter: " + l.first; return false; }
     }
+    llama_lora_adapter_clear(g_state.ctx);
+    for (const auto& l : p.lora)
+        llama_lora_adapter_set(g_state.ctx, g_state.loras[l.first].adapter, l.second);
+    g_state.applied_lora = want;
+    return true;
+}
 
-    return {params, rem};
+// ---------------------------------------------------------------------------
+// Inference parameter parsing (see bridge-protocol.h for the syntax)
+// ---------------------------------------------------------------------------
+static std::pair<InferParams, std::string_view> parse_infer_request(std::string_view args) {
+    TraceSpan span("parse");
+    auto parsed = parse_infer_args(args);
+    if (parsed.first.trace) t_trace_active = true;
+    return parsed;
 }
 
 // ---------------------------------------------------------------------------
@@ -193,21 +757,23 @@ static bool load_model(const std::string& model_path) {
     mp.use_mmap  = true;
     mp.use_mlock = false; // allow OS to swap; reduces pressure in multi-bridge setups
 
-    g_state.model = llama_load_model_from_file(model_path.c_str(), mp);
-    if (!g_state.model) return false;
+    llama_model* model = llama_load_model_from_file(model_path.c_str(), mp);
+    if (!model) return false;
 
     llama_context_params cp = llama_context_default_params();
     cp.n_ctx     = 2048;
     cp.n_threads = 4;
-    cp.n_batch   = 512;
+    cp.n_batch   = N_BATCH;
 
-    g_state.ctx = llama_new_context_with_model(g_state.model, cp);
-    if (!g_state.ctx) {
-        llama_model_free(g_state.model);
-        g_state.model = nullptr;
+    llama_context* ctx = llama_new_context_with_model(model, cp);
+    if (!ctx) {
+        llama_model_free(model);
         return false;
     }
 
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    g_state.model      = model;
+    g_state.ctx        = ctx;
     g_state.model_path = model_path;
     return true;
 }
@@ -221,122 +787,248 @@ static struct llama_sampler* build_sampler(const InferParams& p) {
     struct llama_sampler* smpl = llama_sampler_chain_init(sp);
     llama_sampler_chain_add(smpl, llama_sampler_init_top_p(p.top_p, 1));
     llama_sampler_chain_add(smpl, llama_sampler_init_temp(p.temperature));
-    llama_sampler_chain_add(smpl, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    llama_sampler_chain_add(smpl, llama_sampler_init_dist(p.seed));
     return smpl;
 }
 
+// ---------------------------------------------------------------------------
+// Prompt helpers shared by the inference paths
+// ---------------------------------------------------------------------------
+static bool tokenize_prompt(std::string_view prompt, std::vector<llama_token>& toks) {
+    TraceSpan span("tokenize");
+    toks.resize(prompt.size() + 128);
+    int n = llama_tokenize(g_state.model,
+                           prompt.data(), (int)prompt.size(),
+                           toks.data(), (int)toks.size(),
+                           /*add_bos=*/true, /*special=*/false);
+    if (n < 0) return false;
+    toks.resize(n);
+    return true;
+}
+
+// Response-cache lookup done before admission, so hits never queue behind a
+// running generation. Tokenizing only reads the vocabulary; g_state.mutex
+// keeps LOAD and FREE from swapping the model out meanwhile.
+static bool cache_lookup_prompt(std::string_view prompt, const InferParams& p,
+                                std::vector<std::string>& pieces, int& n_shifts) {
+    if (!cache_enabled_for(p)) return false;
+    std::lock_guard<std::mutex> lock(g_state.mutex);
+    if (!g_state.model) return false;
+
+    std::vector<llama_token> toks;
+    if (!tokenize_prompt(prompt, toks)) return false;
+    return cache_lookup(make_cache_key(toks, p), pieces, n_shifts);
+}
+
+static std::string join_pieces(const std::vector<std::string>& pieces) {
+    std::string out;
+    for (const auto& piece : pieces) out += piece;
+    return out;
+}
+
+// Context shift (ctx_shift=1): when the next n_tokens would overflow n_ctx,
+// keep the first p.keep tokens, drop the oldest half of the rest from the KV
+// cache and slide the remaining positions down. Without ctx_shift the decode
+// is left to fail as before.
+static void ensure_context_room(const InferParams& p, int& n_past, int n_tokens, int& n_shifts) {
+    if (!p.ctx_shift) return;
+    int n_ctx  = (int)llama_n_ctx(g_state.ctx);
+    int n_keep = std::min(std::max(p.keep, 0), n_ctx / 2);
+
+    while (n_past + n_tokens > n_ctx && n_past > n_keep) {
+        TraceSpan span("context_shift");
+        int n_discard = std::max((n_past - n_keep) / 2, 1);
+        llama_kv_cache_seq_rm (g_state.ctx, 0, n_keep, n_keep + n_discard);
+        llama_kv_cache_seq_add(g_state.ctx, 0, n_keep + n_discard, n_past, -n_discard);
+        n_past -= n_discard;
+        ++n_shifts;
+    }
+}
+
+// Evaluate the prompt in n_batch-sized chunks (llama_decode rejects larger batches)
+static bool prefill_prompt(std::vector<llama_token>& toks, const InferParams& p,
+                           int& n_past, int& n_shifts) {
+    for (size_t i = 0; i < toks.size(); i += N_BATCH) {
+        int n = std::min(N_BATCH, (int)(toks.size() - i));
+        ensure_context_room(p, n_past, n, n_shifts);
+        TraceSpan span("prefill");
+        if (llama_decode(g_state.ctx, llama_batch_get_one(toks.data() + i, n, n_past, 0)))
+            return false;
+        n_past += n;
+    }
+    return true;
+}
+
+static llama_token sample_token(struct llama_sampler* smpl) {
+    TraceSpan span("sample");
+    return llama_sampler_sample(smpl, g_state.ctx, -1);
+}
+
+static int token_to_piece(llama_token tok, char* piece, int size) {
+    TraceSpan span("detokenize");
+    return llama_token_to_piece(g_state.model, tok, piece, size, 0, false);
+}
+
+static bool decode_token(llama_token tok, int pos) {
+    TraceSpan span("decode");
+    return llama_decode(g_state.ctx, llama_batch_get_one(&tok, 1, pos, 0)) == 0;
+}
+
 // ---------------------------------------------------------------------------
 // Core inference with real token sampling loop
 // ---------------------------------------------------------------------------
-static std::string perform_inference(const std::string& prompt, const InferParams& p) {
+static std::string perform_inference(std::string_view prompt, const InferParams& p,
+                                     InferStats* stats_out = nullptr) {
     if (!g_state.model || !g_state.ctx)
         return "ERROR: No model loaded";
 
+    std::string err;
+    if (!apply_lora(p, err)) return "ERROR: " + err;
+
     // Clear KV cache for stateless per-request operation
     llama_kv_cache_clear(g_state.ctx);
 
     // Tokenize prompt
-    std::vector<llama_token> toks(prompt.size() + 128);
-    int n_prompt = llama_tokenize(g_state.model,
-                                  prompt.c_str(), (int)prompt.size(),
-                                  toks.data(), (int)toks.size(),
-                                  /*add_bos=*/true, /*special=*/false);
-    if (n_prompt < 0) return "ERROR: Failed to tokenize prompt";
-    toks.resize(n_prompt);
+    std::vector<llama_token> toks;
+    if (!tokenize_prompt(prompt, toks)) return "ERROR: Failed to tokenize prompt";
+    int n_past   = 0;
+    int n_shifts = 0;
+
+    // Hits were answered before admission; record this answer for next time
+    std::string cache_key;
+    if (cache_enabled_for(p)) cache_key = make_cache_key(toks, p);
 
     // Evaluate prompt
-    if (llama_decode(g_state.ctx, llama_batch_get_one(toks.data(), n_prompt, 0, 0)))
+    if (!prefill_prompt(toks, p, n_past, n_shifts))
         return "ERROR: Failed to evaluate prompt";
 
     // Build sampler chain: top-p → temperature → distribution
     struct llama_sampler* smpl = build_sampler(p);
 
     std::string result;
+    std::vector<std::string> pieces;
+    StopStream filter(p.stop);
+    bool complete = false;
     int n_gen = 0;
 
     while (n_gen < p.max_tokens) {
-        llama_token tok = llama_sampler_sample(smpl, g_state.ctx, -1);
+        llama_token tok = sample_token(smpl);
 
-        if (llama_token_is_eog(g_state.model, tok)) break;
+        if (llama_token_is_eog(g_state.model, tok)) { complete = true; break; }
 
         // Decode token to text piece
         char piece[256];
-        int  np = llama_token_to_piece(g_state.model, tok, piece, sizeof(piece), 0, false);
+        int  np = token_to_piece(tok, piece, sizeof(piece));
         if (np < 0) break;
-        result += std::string(piece, np);
+        std::string out = filter.push(std::string(piece, np));
+        result += out;
+        if (!cache_key.empty() && !out.empty()) pieces.push_back(out);
+        if (filter.stopped()) { complete = true; break; }
 
         llama_sampler_accept(smpl, tok);
 
         // Feed generated token back for next prediction
-        if (llama_decode(g_state.ctx,
-                         llama_batch_get_one(&tok, 1, n_prompt + n_gen, 0)))
+        ensure_context_room(p, n_past, 1, n_shifts);
+        if (!decode_token(tok, n_past++))
             break;
         ++n_gen;
     }
+    if (n_gen == p.max_tokens) complete = true;
+
+    std::string tail = filter.flush();
+    result += tail;
+    if (!cache_key.empty() && !tail.empty()) pieces.push_back(tail);
 
     llama_sampler_free(smpl);
+    if (stats_out) *stats_out = {n_shifts, !complete};
+
+    // Only fully generated answers are cached; a failed decode may be transient
+    if (complete && !cache_key.empty())
+        cache_insert(cache_key, std::move(pieces), n_shifts);
     return result;
 }
 
 // ---------------------------------------------------------------------------
 // Streaming inference: sends each token to client as it is generated
 // ---------------------------------------------------------------------------
-static void perform_streaming_inference(int fd, const std::string& prompt,
+static void perform_streaming_inference(Connection& c, std::string_view prompt,
                                         const InferParams& p) {
     if (!g_state.model || !g_state.ctx) {
-        send_response(fd, "error", "No model loaded");
+        send_response(c, "error", "No model loaded");
         return;
     }
 
+    std::string err;
+    if (!apply_lora(p, err)) { send_response(c, "error", err); return; }
+
     llama_kv_cache_clear(g_state.ctx);
 
-    std::vector<llama_token> toks(prompt.size() + 128);
-    int n_prompt = llama_tokenize(g_state.model,
-                                  prompt.c_str(), (int)prompt.size(),
-                                  toks.data(), (int)toks.size(),
-                                  true, false);
-    if (n_prompt < 0) { send_response(fd, "error", "Failed to tokenize prompt"); return; }
-    toks.resize(n_prompt);
+    std::vector<llama_token> toks;
+    if (!tokenize_prompt(prompt, toks)) { send_response(c, "error", "Failed to tokenize prompt"); return; }
+    int n_past   = 0;
+    int n_shifts = 0;
+
+    // Hits were answered before admission; record this stream for next time
+    std::string cache_key;
+    if (cache_enabled_for(p)) cache_key = make_cache_key(toks, p);
 
-    if (llama_decode(g_state.ctx, llama_batch_get_one(toks.data(), n_prompt, 0, 0))) {
-        send_response(fd, "error", "Failed to evaluate prompt");
+    if (!prefill_prompt(toks, p, n_past, n_shifts)) {
+        send_response(c, "error", "Failed to evaluate prompt");
         return;
     }
 
     // Acknowledge streaming start
-    send_response(fd, "ok", "Starting token generation");
+    send_response(c, "ok", "Starting token generation");
 
     struct llama_sampler* smpl = build_sampler(p);
 
+    std::vector<std::string> pieces;
+    StopStream filter(p.stop);
     bool done = false;
     int  n_gen = 0;
 
     while (n_gen < p.max_tokens && !done) {
-        llama_token tok = llama_sampler_sample(smpl, g_state.ctx, -1);
+        llama_token tok = sample_token(smpl);
 
         if (llama_token_is_eog(g_state.model, tok)) {
-            send_stream_token(fd, "", true); // final marker
+            std::string tail = filter.flush();
+            if (!cache_key.empty() && !tail.empty()) pieces.push_back(tail);
+            send_stream_token(c, tail, true, {n_shifts, false}); // final marker
             done = true;
             break;
         }
 
         char piece[256];
-        int  np = llama_token_to_piece(g_state.model, tok, piece, sizeof(piece), 0, false);
+        int  np = token_to_piece(tok, piece, sizeof(piece));
         if (np < 0) break;
 
-        bool is_last = (n_gen == p.max_tokens - 1);
-        send_stream_token(fd, std::string(piece, np), is_last);
+        // Held-back bytes (partial codepoint or stop prefix) go out with a later token
+        std::string out = filter.push(std::string(piece, np));
+        bool is_last = filter.stopped() || (n_gen == p.max_tokens - 1);
+        if (is_last) out += filter.flush();
+        if (!cache_key.empty() && !out.empty()) pieces.push_back(out);
+
+        if (!out.empty() || is_last)
+            send_stream_token(c, out, is_last, {is_last ? n_shifts : 0, false});
         if (is_last) { done = true; break; }
 
+        // Slow or vanished reader: pause only while nobody else needs the engine
+        if (!c.out.throttle()) {
+            std::cerr << "Abandoning stream for client " << c.id << ": reader not keeping up" << std::endl;
+            break;
+        }
+
         llama_sampler_accept(smpl, tok);
-        if (llama_decode(g_state.ctx,
-                         llama_batch_get_one(&tok, 1, n_prompt + n_gen, 0)))
+        ensure_context_room(p, n_past, 1, n_shifts);
+        if (!decode_token(tok, n_past++))
             break;
         ++n_gen;
     }
 
     if (!done)
-        send_stream_token(fd, "", true); // ensure client always gets a final marker
+        send_stream_token(c, filter.flush(), true, {n_shifts, n_gen < p.max_tokens}); // ensure client always gets a final marker
+    else if (!cache_key.empty())
+        cache_insert(cache_key, std::move(pieces), n_shifts);
 
     llama_sampler_free(smpl);
 }
@@ -344,80 +1036,144 @@ static void perform_streaming_inference(int fd, const std::string& prompt,
 // ---------------------------------------------------------------------------
 // Command dispatcher
 // ---------------------------------------------------------------------------
-static void handle_command(int fd, const std::string& cmd_line) {
-    std::istringstream iss(cmd_line);
-    std::string cmd;
-    iss >> cmd;
+// INFER / INFER_STREAM and their _BODY forms. For the _BODY forms the prompt
+// is the length-prefixed body and args may only contain parameters.
+static void handle_infer(Connection& c, bool stream, std::string_view args,
+                         const std::string_view* body) {
+    if (args.empty() && !body) { send_response(c, "error", "No prompt provided"); return; }
+
+    auto [params, prompt] = parse_infer_request(args);
+    if (body) {
+        if (!prompt.empty()) { send_response(c, "error", "Unexpected text after parameters"); return; }
+        prompt = *body;
+    }
+    if (prompt.empty()) { send_response(c, "error", "No prompt after parameters"); return; }
+
+    // Cache hits bypass the scheduler entirely
+    std::vector<std::string> cached;
+    InferStats stats;
+    if (cache_lookup_prompt(prompt, params, cached, stats.n_shifts)) {
+        if (stream) {
+            send_response(c, "ok", "Starting token generation (cached)");
+            for (const auto& piece : cached) send_stream_token(c, piece);
+            send_stream_token(c, "", true, stats);
+        } else {
+            send_response(c, "ok", "Inference completed", join_pieces(cached), stats);
+        }
+        return;
+    }
+
+    EngineSlot slot(c.id, params.batch, estimate_cost(prompt, params));
+    if (!slot.admitted) { send_busy(c, slot); return; }
+
+    if (stream) {
+        perform_streaming_inference(c, prompt, params);
+        return;
+    }
+
+    std::string result = perform_inference(prompt, params, &stats);
+    if (result.compare(0, 6, "ERROR:") == 0)
+        send_response(c, "error", result.substr(7));
+    else
+        send_response(c, "ok", "Inference completed", result, stats);
+}
+
+// body is the payload of an INFER_BODY / INFER_STREAM_BODY command (else null)
+static void handle_command(Connection& c, std::string_view cmd_line, uint64_t recv_ns,
+                           const std::string_view* body = nullptr) {
+    TraceRequest treq(recv_ns);
+    std::string_view rest = cmd_line;
+    std::string_view cmd  = next_word(rest);
+    rest = trim_left(rest);
 
     if (cmd == "PING") {
         // Return "pong" in both message and data fields (Limbo client checks data)
-        send_all(fd, "{\"status\":\"ok\",\"message\":\"pong\",\"data\":\"pong\"}\n");
+        send_all(c, "{\"status\":\"ok\",\"message\":\"pong\",\"data\":\"pong\"}\n");
     }
     else if (cmd == "STATUS") {
-        std::string msg = g_state.model
-            ? "Model loaded: " + g_state.model_path
-            : "No model loaded";
-        send_response(fd, "ok", msg);
+        std::string msg;
+        {
+            std::lock_guard<std::mutex> lock(g_state.mutex);
+            msg = g_state.model ? "Model loaded: " + g_state.model_path : "No model loaded";
+            if (!g_state.loras.empty()) {
+                uint64_t bytes = 0;
+                std::string names;
+                for (const auto& kv : g_state.loras) {
+                    bytes += kv.second.bytes;
+                    names += (names.empty() ? "" : ",") + kv.first;
+                }
+                msg += "; lora: adapters=" + names + " bytes=" + std::to_string(bytes);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_sched.mutex);
+            msg += "; queue: depth="  + std::to_string(g_sched.queue.size())
+                 + " running="        + std::to_string(g_sched.engine_busy ? 1 : 0)
+                 + " tokens="         + std::to_string(g_sched.queued_tokens)
+                 + "/"                + std::to_string(g_sched.token_budget)
+                 + " est_wait_ms="    + std::to_string(estimate_wait_ms_locked())
+                 + " rejected="       + std::to_string(g_sched.rejected);
+        }
+        if (g_cache.max_bytes > 0) {
+            std::lock_guard<std::mutex> lock(g_cache.mutex);
+            msg += "; cache: hits=" + std::to_string(g_cache.hits)
+                 + " misses="    + std::to_string(g_cache.misses)
+                 + " evictions=" + std::to_string(g_cache.evictions)
+                 + " entries="   + std::to_string(g_cache.lru.size())
+                 + " bytes="     + std::to_string(g_cache.bytes)
+                 + "/"           + std::to_string(g_cache.max_bytes);
+        }
+        send_response(c, "ok", msg);
     }
     else if (cmd == "LOAD") {
-        std::string path;
-        std::getline(iss, path);
-        size_t s = path.find_first_not_of(" \t");
-        if (s != std::string::npos) path = path.substr(s);
+        std::string path(rest);
 
-        if (path.empty())          send_response(fd, "error", "No model path provided");
-        else if (load_model(path)) send_response(fd, "ok",    "Model loaded successfully");
-        else                       send_response(fd, "error", "Failed to load model: " + path);
-    }
-    else if (cmd == "INFER") {
-        std::string rest;
-        std::getline(iss, rest);
-        size_t s = rest.find_first_not_of(" \t");
-        if (s != std::string::npos) rest = rest.substr(s);
-
-        if (rest.empty()) { send_response(fd, "error", "No prompt provided"); return; }
+        if (path.empty()) { send_response(c, "error", "No model path provided"); return; }
 
-        auto [params, prompt] = parse_infer_args(rest);
-        if (prompt.empty()) { send_response(fd, "error", "No prompt after parameters"); return; }
-
-        std::string result = perform_inference(prompt, params);
-        if (result.substr(0, 6) == "ERROR:")
-            send_response(fd, "error", result.substr(7));
-        else
-            send_response(fd, "ok", "Inference completed", result);
+        EngineSlot slot(c.id, false, 0, /*force=*/true);
+        if (load_model(path)) send_response(c, "ok",    "Model loaded successfully");
+        else                  send_response(c, "error", "Failed to load model: " + path);
     }
-    else if (cmd == "INFER_STREAM") {
-        std::string rest;
-        std::getline(iss, rest);
-        size_t s = rest.find_first_not_of(" \t");
-        if (s != std::string::npos) rest = rest.substr(s);
+    else if (cmd == "LOAD_LORA") {
+        std::string name(next_word(rest));
+        std::string path(trim_left(rest));
 
-        if (rest.empty()) { send_response(fd, "error", "No prompt provided"); return; }
+        if (name.empty() || path.empty()) { send_response(c, "error", "Usage: LOAD_LORA <name> <path>"); return; }
 
-        auto [params, prompt] = parse_infer_args(rest);
-        if (prompt.empty()) { send_response(fd, "error", "No prompt after parameters"); return; }
+        EngineSlot slot(c.id, false, 0, /*force=*/true);
+        std::string err;
+        if (load_lora(name, path, err)) send_response(c, "ok",    "LoRA adapter loaded: " + name);
+        else                            send_response(c, "error", err);
+    }
+    else if (cmd == "UNLOAD_LORA") {
+        std::string name(next_word(rest));
+        if (name.empty()) { send_response(c, "error", "Usage: UNLOAD_LORA <name>"); return; }
 
-        perform_streaming_inference(fd, prompt, params);
+        EngineSlot slot(c.id, false, 0, /*force=*/true);
+        if (unload_lora(name)) send_response(c, "ok",    "LoRA adapter unloaded: " + name);
+        else                   send_response(c, "error", "Unknown LoRA adapter: " + name);
+    }
+    else if (cmd == "INFER" || cmd == "INFER_STREAM") {
+        handle_infer(c, cmd == "INFER_STREAM", rest, nullptr);
+    }
+    else if ((cmd == "INFER_BODY" || cmd == "INFER_STREAM_BODY") && body) {
+        next_word(rest);  // byte count, already consumed by the reader
+        handle_infer(c, cmd == "INFER_STREAM_BODY", trim_left(rest), body);
     }
     else if (cmd == "INFER_MULTI") {
         // Syntax: INFER_MULTI [params] <prompt1>||<prompt2>||...
-        std::string rest;
-        std::getline(iss, rest);
-        size_t s = rest.find_first_not_of(" \t");
-        if (s != std::string::npos) rest = rest.substr(s);
+        if (rest.empty()) { send_response(c, "error", "No prompts provided"); return; }
 
-        if (rest.empty()) { send_response(fd, "error", "No prompts provided"); return; }
-
-        auto [params, prompts_str] = parse_infer_args(rest);
-        if (prompts_str.empty()) { send_response(fd, "error", "No prompts after parameters"); return; }
+        auto [params, prompts_str] = parse_infer_request(rest);
+        if (prompts_str.empty()) { send_response(c, "error", "No prompts after parameters"); return; }
 
         // Split prompts by "||", skip empty segments
-        std::vector<std::string> prompts;
+        std::vector<std::string_view> prompts;
         size_t pos = 0;
         while (pos < prompts_str.size()) {
             size_t sep = prompts_str.find("||", pos);
-            std::string seg;
-            if (sep == std::string::npos) {
+            std::string_view seg;
+            if (sep == std::string_view::npos) {
                 seg = prompts_str.substr(pos);
                 pos = prompts_str.size();  // exit loop after this iteration
             } else {
@@ -427,54 +1183,255 @@ static void handle_command(int fd, const std::string& cmd_line) {
             if (!seg.empty()) prompts.push_back(seg);
         }
 
-        std::string json_arr = "[";
+        // Cached answers are filled in first; only the misses need the engine
+        std::vector<std::string> results(prompts.size());
+        std::vector<InferStats>  stats(prompts.size());
+        std::vector<bool>        hit(prompts.size(), false);
+        uint64_t cost = 0;
         for (size_t i = 0; i < prompts.size(); i++) {
-            if (i) json_arr += ",";
-            std::string r = perform_inference(prompts[i], params);
-            json_arr += "\"" + escape_json(r) + "\"";
+            std::vector<std::string> pieces;
+            hit[i] = cache_lookup_prompt(prompts[i], params, pieces, stats[i].n_shifts);
+            if (hit[i]) results[i] = join_pieces(pieces);
+            else        cost += estimate_cost(prompts[i], params);
+        }
+
+        if (cost > 0) {
+            EngineSlot slot(c.id, params.batch, cost);
+            if (!slot.admitted) { send_busy(c, slot); return; }
+            for (size_t i = 0; i < prompts.size(); i++)
+                if (!hit[i]) results[i] = perform_inference(prompts[i], params, &stats[i]);
         }
-        json_arr += "]";
 
-        send_response(fd, "ok", "Multi-inference completed", json_arr);
+        // data is a JSON array of result strings; context_shifts[i] and
+        // truncated[i] belong to prompt i
+        send_all(c, build_response_json("ok", "Multi-inference completed",
+                                        build_string_array(results), stats));
+    }
+    else if (cmd == "TRACE") {
+        std::string_view sub  = next_word(rest);
+        std::string      path(next_word(rest));
+
+        if (sub == "on") {
+            g_trace.enabled = true;
+            send_response(c, "ok", "Tracing enabled");
+        } else if (sub == "off") {
+            g_trace.enabled = false;
+            send_response(c, "ok", "Tracing disabled");
+        } else if (sub == "clear") {
+            std::lock_guard<std::mutex> lock(g_trace.mutex);
+            g_trace.head = g_trace.count = 0;
+            send_response(c, "ok", "Trace buffer cleared");
+        } else if (sub == "dump" && path.empty()) {
+            size_t      n_events = 0;
+            std::string json     = trace_to_json(&n_events);
+            send_all(c, build_response_json("ok", std::to_string(n_events) + " trace events", json));
+        } else if (sub == "dump") {
+            // Clients only name a file inside --trace-dir, never an arbitrary path
+            if (g_trace.dir.empty()) {
+                send_response(c, "error", "Trace file dumps need --trace-dir");
+                return;
+            }
+            if (path.find('/') != std::string::npos || path == "." || path == "..") {
+                send_response(c, "error", "Trace file must be a plain file name");
+                return;
+            }
+            path = g_trace.dir + "/" + path;
+            std::ofstream out(path);
+            if (!out) { send_response(c, "error", "Failed to open trace file: " + path); return; }
+            out << trace_to_json() << "\n";
+            send_response(c, "ok", "Trace written to " + path);
+        } else {
+            send_response(c, "error", "Usage: TRACE on|off|clear|dump [file]");
+        }
     }
     else if (cmd == "FREE") {
+        EngineSlot slot(c.id, false, 0, /*force=*/true);
         cleanup_model();
-        send_response(fd, "ok", "Resources freed");
+        send_response(c, "ok", "Resources freed");
     }
     else if (cmd == "QUIT") {
-        send_response(fd, "ok", "Goodbye");
+        send_response(c, "ok", "Goodbye");
         g_state.running = false;
+        shutdown(g_state.srv_fd, SHUT_RDWR);  // wake the accept loop
     }
     else {
-        send_response(fd, "error", "Unknown command: " + cmd);
+        send_response(c, "error", "Unknown command: " + std::string(cmd));
     }
 }
 
 // ---------------------------------------------------------------------------
 // Per-client connection handler
+// Each connection runs on its own thread; the registry lets main() refuse
+// clients beyond --max-clients and wake every reader at shutdown.
 // ---------------------------------------------------------------------------
-static void handle_client(int fd) {
-    char        buf[8192];
-    std::string accumulated;
+struct ClientRegistry {
+    std::mutex                       mutex;
+    std::condition_variable          cv;
+    std::unordered_map<uint64_t, int> fds;
+    uint64_t                         next_id = 0;
+};
 
-    while (g_state.running) {
-        ssize_t n = recv(fd, buf, sizeof(buf) - 1, 0);
+static ClientRegistry g_clients;
+
+// Receive buffer consumed in place: lines and bodies are returned as views
+// into it, and bytes are only moved when the free tail runs out, so a
+// request costs time linear in its size however it is split across recv()s.
+// Views stay valid until the next fill().
+class RecvBuffer {
+public:
+    ssize_t fill(int fd) {
+        if (end_ == buf_.size()) make_room(buf_.size());
+        ssize_t n = recv(fd, buf_.data() + end_, buf_.size() - end_, 0);
+        if (n > 0) end_ += n;
+        return n;
+    }
+
+    // Next complete line without its terminator ('\n' or "\r\n")
+    bool next_line(std::string_view& line) {
+        const char* nl = (const char*)memchr(buf_.data() + scanned_, '\n', end_ - scanned_);
+        if (!nl) { scanned_ = end_; return false; }
+
+        size_t pos = nl - buf_.data();
+        size_t len = pos - begin_;
+        if (len > 0 && buf_[pos - 1] == '\r') len--;
+        line = std::string_view(buf_.data() + begin_, len);
+        consume(pos + 1 - begin_);
+        return true;
+    }
+
+    // Caller checks size() >= n first
+    std::string_view take(size_t n) {
+        std::string_view v(buf_.data() + begin_, n);
+        consume(n);
+        return v;
+    }
+
+    size_t skip(size_t n) {
+        n = std::min(n, size());
+        consume(n);
+        return n;
+    }
+
+    size_t size() const { return end_ - begin_; }
+
+    // Ensure n unread bytes fit without further reallocation
+    void reserve(size_t n) { if (begin_ + n > buf_.size()) make_room(n); }
+
+private:
+    void consume(size_t n) {
+        begin_  += n;
+        scanned_ = std::max(scanned_, begin_);
+        if (begin_ == end_) begin_ = end_ = scanned_ = 0;
+    }
+
+    // Slide unread bytes to the front, growing if they still leave no room
+    void make_room(size_t want) {
+        size_t live = size();
+        if (begin_ > 0) {
+            memmove(buf_.data(), buf_.data() + begin_, live);
+            scanned_ -= begin_;
+            begin_ = 0;
+            end_   = live;
+        }
+        if (end_ == buf_.size() || want > buf_.size())
+            buf_.resize(std::max(buf_.size() * 2, want));
+    }
+
+    std::vector<char> buf_ = std::vector<char>(64 * 1024);
+    size_t begin_   = 0;   // first unread byte
+    size_t end_     = 0;   // one past the last received byte
+    size_t scanned_ = 0;   // bytes before this hold no '\n'
+};
+
+enum class BodyHeader { none, valid, malformed };
+
+// Classifies line as an INFER_BODY / INFER_STREAM_BODY header and reads its
+// byte count. A malformed header leaves the payload length unknown.
+static BodyHeader body_length(std::string_view line, size_t& n) {
+    std::string_view cmd = next_word(line);
+    if (cmd != "INFER_BODY" && cmd != "INFER_STREAM_BODY") return BodyHeader::none;
+    std::string_view num = next_word(line);
+    if (num.empty() || num.size() > 19 ||
+        num.find_first_not_of("0123456789") != std::string_view::npos)
+        return BodyHeader::malformed;
+    n = std::strtoull(std::string(num).c_str(), nullptr, 10);
+    return BodyHeader::valid;
+}
+
+static void handle_client(int fd, uint64_t client_id) {
+    RecvBuffer  in;
+    Connection  conn{fd, client_id, {}};
+    std::thread writer(writer_loop, &conn);
+
+    std::string body_cmd;      // header of a body command awaiting its payload
+    size_t      body_len = 0;
+    size_t      discard  = 0;  // bytes of a rejected body still to skip
+    bool        open     = true;
+
+    while (open && g_state.running) {
+        ssize_t n = in.fill(fd);
         if (n <= 0) break;
+        uint64_t recv_ns = trace_now_ns();
 
-        buf[n] = '\0';
-        accumulated += buf;
+        // Handle every complete request in the buffer before reading again
+        for (;;) {
+            if (discard > 0) {
+                discard -= in.skip(discard);
+                if (discard > 0) break;
+            }
+            if (!body_cmd.empty()) {
+                if (in.size() < body_len) break;
+                std::string_view body = in.take(body_len);
+                handle_command(conn, body_cmd, recv_ns, &body);
+                body_cmd.clear();
+                continue;
+            }
 
-        size_t pos;
-        while ((pos = accumulated.find('\n')) != std::string::npos) {
-            std::string line = accumulated.substr(0, pos);
-            accumulated      = accumulated.substr(pos + 1);
-            // Strip carriage return
-            if (!line.empty() && line.back() == '\r') line.pop_back();
-            if (!line.empty()) handle_command(fd, line);
+            std::string_view line;
+            if (!in.next_line(line)) {
+                if (in.size() > g_state.max_request_bytes) {
+                    send_response(conn, "error", "Request line too long");
+                    open = false;
+                }
+                break;
+            }
+            if (line.size() > g_state.max_request_bytes) {
+                send_response(conn, "error", "Request line too long");
+                open = false;
+                break;
+            }
+            if (line.empty()) continue;
+
+            size_t     len  = 0;
+            BodyHeader kind = body_length(line, len);
+            if (kind == BodyHeader::none) {
+                handle_command(conn, line, recv_ns);
+            } else if (kind == BodyHeader::malformed) {
+                // The payload that follows can't be skipped safely; parsing it
+                // as commands could execute prompt text, so drop the connection
+                send_response(conn, "error", "Usage: INFER_BODY|INFER_STREAM_BODY <nbytes> [params]");
+                open = false;
+                break;
+            } else if (len > g_state.max_request_bytes) {
+                send_response(conn, "error", "Request body too large");
+                discard = len;
+            } else {
+                body_cmd.assign(line);
+                body_len = len;
+                in.reserve(len);
+            }
         }
     }
 
+    conn.out.close();
+    writer.join();
     close(fd);
+    sched_forget_client(client_id);
+    std::cout << "Client disconnected" << std::endl;
+
+    std::lock_guard<std::mutex> lock(g_clients.mutex);
+    g_clients.fds.erase(client_id);
+    g_clients.cv.notify_all();
 }
 
 // ---------------------------------------------------------------------------
@@ -486,10 +1443,45 @@ int main(int argc, char** argv) {
         std::string arg(argv[i]);
         if ((arg == "--socket-path" || arg == "-s") && i + 1 < argc) {
             g_state.socket_path = argv[++i];
+        } else if (arg == "--cache-bytes" && i + 1 < argc) {
+            g_cache.max_bytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--cache-ttl" && i + 1 < argc) {
+            g_cache.ttl_seconds = std::atoi(argv[++i]);
+        } else if (arg == "--trace-events" && i + 1 < argc) {
+            g_trace.capacity = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "--trace-dir" && i + 1 < argc) {
+            g_trace.dir = argv[++i];
+        } else if (arg == "--max-clients" && i + 1 < argc) {
+            g_state.max_clients = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "--max-queue" && i + 1 < argc) {
+            g_sched.max_queue = std::max(1L, std::atol(argv[++i]));
+        } else if (arg == "--token-budget" && i + 1 < argc) {
+            g_sched.token_budget = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--out-high-water" && i + 1 < argc) {
+            OutputQueue::high_water = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--out-stall-ms" && i + 1 < argc) {
+            OutputQueue::stall_ms = std::atoi(argv[++i]);
+        } else if (arg == "--max-request-bytes" && i + 1 < argc) {
+            g_state.max_request_bytes = std::max(1ULL, std::strtoull(argv[++i], nullptr, 10));
         } else if (arg == "--help" || arg == "-h") {
-            std::cout << "Usage: llama-cpp-bridge [--socket-path <path>]\n"
+            std::cout << "Usage: llama-cpp-bridge [--socket-path <path>] [--cache-bytes N] [--cache-ttl S]\n"
+                      << "                        [--trace-events N] [--trace-dir DIR] [--max-clients N]\n"
+                      << "                        [--max-queue N] [--token-budget N] [--out-high-water N]\n"
+                      << "                        [--out-stall-ms MS] [--max-request-bytes N]\n"
                       << "  --socket-path  Unix socket path "
-                      << "(default: " << DEFAULT_SOCKET_PATH << ")\n";
+                      << "(default: " << DEFAULT_SOCKET_PATH << ")\n"
+                      << "  --cache-bytes  Response cache budget in bytes (default: 0, disabled)\n"
+                      << "  --cache-ttl    Response cache entry lifetime in seconds (default: 3600)\n"
+                      << "  --trace-events Trace ring buffer capacity (default: 65536)\n"
+                      << "  --trace-dir    Directory TRACE dump <file> writes into (default: none,\n"
+                      << "                 only inline dumps)\n"
+                      << "  --max-clients  Concurrent connections (default: 64)\n"
+                      << "  --max-queue    Queued inference requests before busy (default: 32)\n"
+                      << "  --token-budget Queued prompt+max_tokens before busy (default: 65536)\n"
+                      << "  --out-high-water Queued output bytes per client before its stream\n"
+                      << "                 is throttled (default: 1048576)\n"
+                      << "  --out-stall-ms Abandon a throttled stream after this long (default: 2000)\n"
+                      << "  --max-request-bytes Longest command line or request body (default: 16777216)\n";
             return 0;
         }
     }
@@ -497,11 +1489,16 @@ int main(int argc, char** argv) {
     std::cout << "llama-cpp-bridge starting...\n"
               << "Socket: " << g_state.socket_path << std::endl;
 
-    signal(SIGINT,  signal_handler);
-    signal(SIGTERM, signal_handler);
+    // No SA_RESTART, so a signal interrupts the blocking accept()
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT,  &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
 
     int srv_fd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (srv_fd < 0) { std::cerr << "Failed to create socket\n"; return 1; }
+    g_state.srv_fd = srv_fd;
 
     unlink(g_state.socket_path);
 
@@ -529,9 +1526,34 @@ int main(int argc, char** argv) {
             if (g_state.running) std::cerr << "Failed to accept connection\n";
             continue;
         }
+
+        std::unique_lock<std::mutex> lock(g_clients.mutex);
+        if (g_clients.fds.size() >= g_state.max_clients) {
+            lock.unlock();
+            write_fd(cli_fd, "{\"status\":\"busy\",\"message\":\"Too many clients\"}\n");
+            close(cli_fd);
+            continue;
+        }
+        uint64_t id = ++g_clients.next_id;
+        g_clients.fds[id] = cli_fd;
+        lock.unlock();
+
         std::cout << "Client connected" << std::endl;
-        handle_client(cli_fd);
-        std::cout << "Client disconnected" << std::endl;
+        std::thread(handle_client, cli_fd, id).detach();
+    }
+
+    // Wake every client reader and wait for in-flight requests to finish.
+    // Only the read side is shut down so each handler's writer can still
+    // drain queued replies; a peer that stops reading gets its write side
+    // cut after a grace period so it cannot hold up the exit.
+    {
+        std::unique_lock<std::mutex> lock(g_clients.mutex);
+        for (auto& kv : g_clients.fds) shutdown(kv.second, SHUT_RD);
+        auto drained = [] { return g_clients.fds.empty(); };
+        if (!g_clients.cv.wait_for(lock, std::chrono::seconds(SHUTDOWN_GRACE_SECONDS), drained)) {
+            for (auto& kv : g_clients.fds) shutdown(kv.second, SHUT_RDWR);
+            g_clients.cv.wait(lock, drained);
+        }
     }
 
     cleanup();
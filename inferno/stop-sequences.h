@@ -0,0 +1,149 @@
+/**
+ * stop-sequences.h: incremental stop-string matching for token streams
+ *
+ * Shared by llama-cpp-bridge and the Electron addon. Generated pieces are fed
+ * byte by byte through an Aho-Corasick automaton built over all stop strings,
+ * so a match is found the moment it completes, even when it spans several
+ * tokens. StopStream only holds back the bytes that could still turn into a
+ * stop match or that end in an incomplete UTF-8 sequence; everything else is
+ * released immediately.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <queue>
+
+// ---------------------------------------------------------------------------
+// Aho-Corasick automaton over bytes
+// ---------------------------------------------------------------------------
+class StopMatcher {
+public:
+    explicit StopMatcher(const std::vector<std::string>& stops) {
+        nodes_.emplace_back();
+        for (const auto& s : stops) {
+            if (s.empty()) continue;
+            int cur = 0;
+            for (unsigned char c : s) {
+                if (nodes_[cur].next[c] < 0) {
+                    nodes_[cur].next[c] = (int)nodes_.size();
+                    nodes_.emplace_back();
+                    nodes_.back().depth = nodes_[cur].depth + 1;
+                }
+                cur = nodes_[cur].next[c];
+            }
+            nodes_[cur].match_len = (int)s.size();
+        }
+        build_links();
+    }
+
+    bool empty() const { return nodes_.size() == 1; }
+
+    // Advance by one byte; returns the length of the stop string that ends
+    // here (0 if none).
+    int step(unsigned char c) {
+        state_ = nodes_[state_].next[c];
+        return nodes_[state_].match_len;
+    }
+
+    // Length of the longest stream suffix that is a prefix of some stop string
+    int pending() const { return nodes_[state_].depth; }
+
+private:
+    struct Node {
+        int next[256];
+        int fail      = 0;
+        int depth     = 0;
+        int match_len = 0;  // longest stop string ending at this node
+        Node() { for (int& n : next) n = -1; }
+    };
+
+    // BFS fills failure links and turns the trie into a full goto function
+    void build_links() {
+        std::queue<int> q;
+        for (int& n : nodes_[0].next) {
+            if (n < 0) n = 0;
+            else q.push(n);
+        }
+        while (!q.empty()) {
+            int u = q.front();
+            q.pop();
+            int f = nodes_[u].fail;
+            if (nodes_[u].match_len == 0) nodes_[u].match_len = nodes_[f].match_len;
+            for (int c = 0; c < 256; c++) {
+                int v = nodes_[u].next[c];
+                if (v < 0) {
+                    nodes_[u].next[c] = nodes_[f].next[c];
+                } else {
+                    nodes_[v].fail = nodes_[f].next[c];
+                    q.push(v);
+                }
+            }
+        }
+    }
+
+    std::vector<Node> nodes_;
+    int state_ = 0;
+};
+
+// Largest k <= n such that s[0, k) does not end inside a UTF-8 sequence
+inline size_t utf8_safe_prefix(const std::string& s, size_t n) {
+    size_t j = n;
+    while (j > 0 && n - j < 3 && ((unsigned char)s[j - 1] & 0xC0) == 0x80) --j;
+    if (j == 0) return n;
+
+    unsigned char lead = (unsigned char)s[j - 1];
+    size_t len = (lead & 0xE0) == 0xC0 ? 2
+               : (lead & 0xF0) == 0xE0 ? 3
+               : (lead & 0xF8) == 0xF0 ? 4
+               : 1;
+    return (n - (j - 1) >= len) ? n : j - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming filter: feed pieces in, get text that is safe to emit out
+// ---------------------------------------------------------------------------
+class StopStream {
+public:
+    explicit StopStream(const std::vector<std::string>& stops) : matcher_(stops) {}
+
+    // Returns the text that can be emitted after this piece. Once a stop
+    // string matches, the text preceding it is returned and stopped() is set;
+    // the stop string itself is never emitted.
+    std::string push(const std::string& piece) {
+        if (stopped_) return "";
+        held_ += piece;
+
+        if (!matcher_.empty()) {
+            for (size_t i = held_.size() - piece.size(); i < held_.size(); i++) {
+                int len = matcher_.step((unsigned char)held_[i]);
+                if (len > 0) {
+                    stopped_ = true;
+                    std::string out = held_.substr(0, i + 1 - len);
+                    held_.clear();
+                    return out;
+                }
+            }
+        }
+
+        size_t cut = utf8_safe_prefix(held_, held_.size() - matcher_.pending());
+        std::string out = held_.substr(0, cut);
+        held_.erase(0, cut);
+        return out;
+    }
+
+    // Releases whatever is still held at end of generation
+    std::string flush() {
+        std::string out;
+        out.swap(held_);
+        return out;
+    }
+
+    bool stopped() const { return stopped_; }
+
+private:
+    StopMatcher matcher_;
+    std::string held_;
+    bool        stopped_ = false;
+};
@@ -10,7 +10,8 @@
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")",
         "../../llama.cpp/include",
-        "../../llama.cpp/ggml/include"
+        "../../llama.cpp/ggml/include",
+        "../../inferno"
       ],
       "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ],
       "libraries": [
@@ -2,6 +2,7 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <queue>
 #include <vector>
@@ -12,9 +13,12 @@
 #include <ctime>
 #include <random>
 #include <algorithm>
+#include <iomanip>
+#include <map>
 
 // Include llama.cpp headers
 #include "llama.h"
+#include "stop-sequences.h"
 
 // Function to get timestamp for logging
 std::string getTimestamp() {
@@ -53,10 +57,92 @@ private:
 // Global logger instance
 Logger logger;
 
+// Tracer records nanosecond spans into a fixed-size ring buffer and exports
+// them as Chrome/Perfetto trace-event JSON. Spans come from worker threads
+// while the dump is requested from the JS thread, hence the mutex.
+class Tracer {
+public:
+    explicit Tracer(size_t capacity = 65536) : events(capacity) {}
+
+    static uint64_t nowNs() {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs, uint64_t track) {
+        if (!enabled) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        events[head] = {name, startNs, endNs - startNs, track};
+        head = (head + 1) % events.size();
+        if (count < events.size()) count++;
+    }
+
+    std::string toJson() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        size_t first = (head + events.size() - count) % events.size();
+        for (size_t i = 0; i < count; i++) {
+            const Event& e = events[(first + i) % events.size()];
+            if (i) out << ",";
+            out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << e.track
+                << std::fixed << std::setprecision(3)
+                << ",\"ts\":" << e.startNs / 1000.0
+                << ",\"dur\":" << e.durNs / 1000.0 << "}";
+        }
+        out << "]}";
+        return out.str();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = count = 0;
+    }
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t durNs;
+        uint64_t track;
+    };
+
+    std::vector<Event> events;
+    size_t head = 0;
+    size_t count = 0;
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+};
+
+// Global tracer instance
+Tracer tracer;
+
+// RAII span for the tracer; each worker is its own track
+class TraceSpan {
+public:
+    TraceSpan(const char* name, uint64_t track)
+        : name(name), track(track), startNs(Tracer::nowNs()) {}
+    ~TraceSpan() { tracer.record(name, startNs, Tracer::nowNs(), track); }
+
+private:
+    const char* name;
+    uint64_t track;
+    uint64_t startNs;
+};
+
+static std::atomic<uint64_t> nextTraceTrack{1};
+
 class LlamaWorker : public Napi::AsyncWorker {
 public:
-    LlamaWorker(Napi::Function& callback, std::string modelPath, std::string prompt)
-        : Napi::AsyncWorker(callback), modelPath(modelPath), prompt(prompt), result("") {
+    LlamaWorker(Napi::Function& callback, std::string modelPath, std::string prompt,
+                std::vector<std::string> stop = {})
+        : Napi::AsyncWorker(callback), modelPath(modelPath), prompt(prompt), result(""),
+          stop(std::move(stop)), traceTrack(nextTraceTrack++) {
         logger.log("LlamaWorker constructor called with model: " + modelPath);
     }
 
@@ -81,6 +167,7 @@ protected:
         logger.log("Model path: " + modelPath);
         logger.log("Prompt length: " + std::to_string(prompt.length()) + " characters");
         logger.log("Prompt content: " + prompt);
+        TraceSpan executeSpan("execute", traceTrack);
 
         try {
             // Initialize llama backend
@@ -95,7 +182,10 @@ protected:
             
             // Step 2: Load the model
             logger.log("Step 2: Loading model from " + modelPath);
-            model = llama_load_model_from_file(modelPath.c_str(), model_params);
+            {
+                TraceSpan span("load_model", traceTrack);
+                model = llama_load_model_from_file(modelPath.c_str(), model_params);
+            }
             
             if (model == nullptr) {
                 logger.log("ERROR: Failed to load model from " + modelPath);
@@ -117,7 +207,10 @@ protected:
             ctx_params.n_batch = 512; // Batch size for prompt evaluation
             
             // Step 4: Create context
-            ctx = llama_new_context_with_model(model, ctx_params);
+            {
+                TraceSpan span("create_context", traceTrack);
+                ctx = llama_new_context_with_model(model, ctx_params);
+            }
             
             if (ctx == nullptr) {
                 logger.log("ERROR: Failed to create context");
@@ -132,7 +225,11 @@ protected:
             
             const auto vocab = llama_model_get_vocab(model);
             std::vector<llama_token> tokens(256);
-            int n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), tokens.data(), tokens.size(), true, false);
+            int n_tokens;
+            {
+                TraceSpan span("tokenize", traceTrack);
+                n_tokens = llama_tokenize(vocab, prompt.c_str(), prompt.length(), tokens.data(), tokens.size(), true, false);
+            }
             
             if (n_tokens < 0) {
                 n_tokens = 0;
@@ -164,7 +261,12 @@ protected:
             
             batch.n_tokens = n_tokens; // Ensure n_tokens is set correctly
             
-            if (llama_decode(ctx, batch) != 0) {
+            int prefillStatus;
+            {
+                TraceSpan span("prefill", traceTrack);
+                prefillStatus = llama_decode(ctx, batch);
+            }
+            if (prefillStatus != 0) {
                 logger.log("ERROR: Failed to decode prompt");
                 llama_batch_free(batch);
                 result = "Failed to process prompt";
@@ -185,6 +287,10 @@ protected:
             // Number of tokens to generate
             const int max_new_tokens = 128;
             
+            // Stop strings are matched across token boundaries; text is only
+            // appended once it can no longer be part of a stop match
+            StopStream stopFilter(stop);
+            
             // Generation loop
             llama_token new_token = 0;
             int prev_token_pos = n_tokens - 1;
@@ -208,29 +314,38 @@ protected:
                 next_batch.n_tokens = 1; // Ensure n_tokens is set correctly
                 
                 // Process the token
-                if (llama_decode(ctx, next_batch) != 0) {
+                int decodeStatus;
+                {
+                    TraceSpan span("decode", traceTrack);
+                    decodeStatus = llama_decode(ctx, next_batch);
+                }
+                if (decodeStatus != 0) {
                     logger.log("ERROR: Failed to decode token " + std::to_string(i));
                     llama_batch_free(next_batch);
                     break;
                 }
                 
-                // Get the logits for the last token
-                const float* logits = llama_get_logits(ctx);
-                
-                // Simple greedy sampling (just take the highest probability token)
-                int vocab_size = llama_vocab_n_tokens(vocab);
-                int best_token_id = 0;
-                float best_score = -INFINITY;
-                
-                for (int token_id = 0; token_id < vocab_size; token_id++) {
-                    if (logits[token_id] > best_score) {
-                        best_score = logits[token_id];
-                        best_token_id = token_id;
+                {
+                    TraceSpan span("sample", traceTrack);
+
+                    // Get the logits for the last token
+                    const float* logits = llama_get_logits(ctx);
+                    
+                    // Simple greedy sampling (just take the highest probability token)
+                    int vocab_size = llama_vocab_n_tokens(vocab);
+                    int best_token_id = 0;
+                    float best_score = -INFINITY;
+                    
+                    for (int token_id = 0; token_id < vocab_size; token_id++) {
+                        if (logits[token_id] > best_score) {
+                            best_score = logits[token_id];
+                            best_token_id = token_id;
+                        }
                     }
+                    
+                    new_token = best_token_id;
                 }
                 
-                new_token = best_token_id;
-                
                 // Check for EOS token
                 if (new_token == token_eos) {
                     logger.log("Generated EOS token, stopping generation");
@@ -238,12 +353,20 @@ protected:
                     break;
                 }
                 
-                // Convert token to text
-                char buffer[8];
-                int token_len = llama_token_to_piece(vocab, new_token, buffer, sizeof(buffer), 0, true);
+                // Convert token to text; a negative length is the size actually needed
+                std::string token_text(64, '\0');
+                int token_len;
+                {
+                    TraceSpan span("detokenize", traceTrack);
+                    token_len = llama_token_to_piece(vocab, new_token, &token_text[0], token_text.size(), 0, true);
+                    if (token_len < 0) {
+                        token_text.resize(-token_len);
+                        token_len = llama_token_to_piece(vocab, new_token, &token_text[0], token_text.size(), 0, true);
+                    }
+                }
                 if (token_len > 0) {
-                    std::string token_text(buffer, token_len);
-                    generated_text << token_text;
+                    token_text.resize(token_len);
+                    generated_text << stopFilter.push(token_text);
                     
                     // Log every few tokens
                     if (i % 5 == 0 || i == max_new_tokens - 1) {
@@ -254,7 +377,13 @@ protected:
                 
                 // Free the batch
                 llama_batch_free(next_batch);
+                
+                if (stopFilter.stopped()) {
+                    logger.log("Matched stop sequence, stopping generation");
+                    break;
+                }
             }
+            generated_text << stopFilter.flush();
             
             // Free the original batch
             llama_batch_free(batch);
@@ -291,37 +420,464 @@ private:
     std::string modelPath;
     std::string prompt;
     std::string result;
+    std::vector<std::string> stop;
+    uint64_t traceTrack;
     
     // llama.cpp model and context
     struct llama_model* model = nullptr;
     struct llama_context* ctx = nullptr;
 };
 
+// Reads an array of strings from options[key], if present
+static void readStringArray(const Napi::Object& options, const char* key, std::vector<std::string>& out) {
+    if (!options.Has(key) || !options.Get(key).IsArray()) return;
+    Napi::Array array = options.Get(key).As<Napi::Array>();
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        Napi::Value v = array.Get(i);
+        if (v.IsString()) out.push_back(v.As<Napi::String>().Utf8Value());
+    }
+}
+
+static int readInt(const Napi::Object& options, const char* key, int fallback) {
+    if (!options.Has(key) || !options.Get(key).IsNumber()) return fallback;
+    return std::max(1, options.Get(key).As<Napi::Number>().Int32Value());
+}
+
 Napi::Value ProcessPrompt(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     logger.log("ProcessPrompt function called");
 
-    // Check arguments
-    if (info.Length() < 3 || !info[0].IsString() || !info[1].IsString() || !info[2].IsFunction()) {
+    // Check arguments; an options object may sit between prompt and callback
+    size_t cbIndex = info.Length() - 1;
+    if (info.Length() < 3 || info.Length() > 4 || !info[0].IsString() || !info[1].IsString() ||
+        !info[cbIndex].IsFunction() || (info.Length() == 4 && !info[2].IsObject())) {
         logger.log("Invalid arguments provided to ProcessPrompt");
-        Napi::TypeError::New(env, "Expected arguments: modelPath (string), prompt (string), callback (function)").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected arguments: modelPath (string), prompt (string), [options (object)], callback (function)").ThrowAsJavaScriptException();
         return env.Null();
     }
 
     std::string modelPath = info[0].As<Napi::String>().Utf8Value();
     std::string prompt = info[1].As<Napi::String>().Utf8Value();
-    Napi::Function callback = info[2].As<Napi::Function>();
+    Napi::Function callback = info[cbIndex].As<Napi::Function>();
+    
+    // options.stop: array of stop strings
+    std::vector<std::string> stop;
+    if (info.Length() == 4) {
+        readStringArray(info[2].As<Napi::Object>(), "stop", stop);
+    }
     
     logger.log("Creating LlamaWorker with model: " + modelPath);
 
     // Create and queue the async worker
-    LlamaWorker* worker = new LlamaWorker(callback, modelPath, prompt);
+    LlamaWorker* worker = new LlamaWorker(callback, modelPath, prompt, std::move(stop));
     worker->Queue();
     logger.log("LlamaWorker queued for execution");
 
     return env.Undefined();
 }
 
+// Sessions keep a conversation's context (and so its KV cache) alive between
+// turns. history is every token of the conversation; the first nPast of them
+// are in the KV cache. Evicting a session frees its context but keeps the
+// history, and the next turn re-prefills it.
+struct ChatSession {
+    uint32_t id;
+    std::string modelPath;
+    int contextSize = 2048;
+    int maxTokens = 128;
+    std::vector<std::string> stop;
+
+    std::shared_ptr<llama_model> model;
+    llama_context* ctx = nullptr;
+    std::vector<llama_token> history;
+    size_t nPast = 0;
+
+    std::mutex turnMutex;       // held for the whole of a turn
+    uint64_t lastUsed = 0;      // guarded by SessionRegistry::mutex
+    bool resident = false;      // guarded by SessionRegistry::mutex
+
+    ~ChatSession() {
+        if (ctx != nullptr) llama_free(ctx);
+    }
+};
+
+// Owns all sessions, shares one loaded model between sessions using the same
+// file, and caps how many sessions hold a context at once.
+class SessionRegistry {
+public:
+    uint32_t create(const std::string& modelPath, int contextSize, int maxTokens,
+                    std::vector<std::string> stop) {
+        auto s = std::make_shared<ChatSession>();
+        s->modelPath = modelPath;
+        s->contextSize = contextSize;
+        s->maxTokens = maxTokens;
+        s->stop = std::move(stop);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        s->id = nextId++;
+        sessions[s->id] = s;
+        return s->id;
+    }
+
+    std::shared_ptr<ChatSession> get(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = sessions.find(id);
+        return it == sessions.end() ? nullptr : it->second;
+    }
+
+    // A turn still running on the session keeps it alive until it finishes
+    bool dispose(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sessions.erase(id) > 0;
+    }
+
+    std::shared_ptr<llama_model> acquireModel(const std::string& path) {
+        std::lock_guard<std::mutex> lock(modelMutex);
+        if (auto model = models[path].lock()) return model;
+
+        llama_backend_init();
+        llama_model_params params = llama_model_default_params();
+        params.use_mmap = true;
+        llama_model* raw = llama_load_model_from_file(path.c_str(), params);
+        if (raw == nullptr) return nullptr;
+
+        std::shared_ptr<llama_model> model(raw, llama_model_free);
+        models[path] = model;
+        return model;
+    }
+
+    // Called with s->turnMutex held, before s creates a context. Frees the
+    // contexts of the least recently used idle sessions until s fits under
+    // the cap; sessions busy with a turn are never evicted.
+    void makeResident(ChatSession* s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t resident = 0;
+        for (auto& kv : sessions)
+            if (kv.second->resident && kv.second.get() != s) resident++;
+
+        while (resident >= maxResident) {
+            ChatSession* victim = nullptr;
+            for (auto& kv : sessions) {
+                ChatSession* c = kv.second.get();
+                if (c == s || !c->resident) continue;
+                if (!victim || c->lastUsed < victim->lastUsed) {
+                    if (!c->turnMutex.try_lock()) continue;
+                    if (victim) victim->turnMutex.unlock();
+                    victim = c;
+                }
+            }
+            if (!victim) break;  // everyone else is mid-turn; run over the cap
+
+            logger.log("Evicting session " + std::to_string(victim->id) + " (" +
+                       std::to_string(victim->history.size()) + " tokens)");
+            llama_free(victim->ctx);
+            victim->ctx = nullptr;
+            victim->nPast = 0;
+            victim->resident = false;
+            victim->turnMutex.unlock();
+            resident--;
+        }
+
+        s->resident = true;
+        s->lastUsed = ++clock;
+    }
+
+    // Called with s->turnMutex held
+    void release(ChatSession* s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (s->ctx != nullptr) llama_free(s->ctx);
+        s->ctx = nullptr;
+        s->nPast = 0;
+        s->resident = false;
+    }
+
+    void touch(ChatSession* s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        s->lastUsed = ++clock;
+    }
+
+    void setMaxResident(size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        maxResident = std::max<size_t>(1, n);
+    }
+
+private:
+    std::mutex mutex;
+    std::map<uint32_t, std::shared_ptr<ChatSession>> sessions;
+    size_t maxResident = 4;
+    uint32_t nextId = 1;
+    uint64_t clock = 0;
+
+    std::mutex modelMutex;  // model loads are slow; keep them off the registry lock
+    std::map<std::string, std::weak_ptr<llama_model>> models;
+};
+
+// Global session registry
+SessionRegistry sessionRegistry;
+
+class SessionWorker : public Napi::AsyncWorker {
+public:
+    SessionWorker(Napi::Function& callback, std::shared_ptr<ChatSession> session,
+                  std::string text, int maxTokens, std::vector<std::string> stop)
+        : Napi::AsyncWorker(callback), session(std::move(session)), text(std::move(text)),
+          maxTokens(maxTokens), stop(std::move(stop)), traceTrack(nextTraceTrack++) {}
+
+protected:
+    void Execute() override {
+        std::lock_guard<std::mutex> turn(session->turnMutex);
+        TraceSpan executeSpan("turn", traceTrack);
+        logger.log("Session " + std::to_string(session->id) + ": turn of " +
+                   std::to_string(text.length()) + " characters");
+
+        if (!session->model) {
+            TraceSpan span("load_model", traceTrack);
+            session->model = sessionRegistry.acquireModel(session->modelPath);
+            if (!session->model) {
+                SetError("Failed to load model from " + session->modelPath);
+                return;
+            }
+        }
+
+        if (session->ctx == nullptr) {
+            TraceSpan span("create_context", traceTrack);
+            sessionRegistry.makeResident(session.get());
+            llama_context_params ctx_params = llama_context_default_params();
+            ctx_params.n_ctx = session->contextSize;
+            ctx_params.n_threads = 4;
+            ctx_params.n_batch = BATCH_SIZE;
+            session->ctx = llama_new_context_with_model(session->model.get(), ctx_params);
+            session->nPast = 0;
+            if (session->ctx == nullptr) {
+                sessionRegistry.release(session.get());
+                SetError("Failed to create context");
+                return;
+            }
+        } else {
+            sessionRegistry.touch(session.get());
+        }
+
+        const llama_vocab* vocab = llama_model_get_vocab(session->model.get());
+
+        // Only the new turn is tokenized. Special tokens are parsed so chat
+        // template markers in the text map to their control tokens.
+        std::vector<llama_token> tokens(text.length() + 2);
+        {
+            TraceSpan span("tokenize", traceTrack);
+            bool addBos = session->history.empty();
+            int n = llama_tokenize(vocab, text.c_str(), text.length(), tokens.data(), tokens.size(), addBos, true);
+            if (n < 0) {
+                tokens.resize(-n);
+                n = llama_tokenize(vocab, text.c_str(), text.length(), tokens.data(), tokens.size(), addBos, true);
+            }
+            tokens.resize(std::max(n, 0));
+        }
+        if (tokens.empty()) {
+            SetError("Empty message after tokenization");
+            return;
+        }
+        if (session->history.size() + tokens.size() >= (size_t)session->contextSize) {
+            SetError("Conversation no longer fits in the session context (" +
+                     std::to_string(session->contextSize) + " tokens)");
+            return;
+        }
+        session->history.insert(session->history.end(), tokens.begin(), tokens.end());
+
+        // Prefill whatever the KV cache is missing: normally just this turn,
+        // the whole history after an eviction
+        {
+            TraceSpan span("prefill", traceTrack);
+            size_t prefilled = session->history.size() - session->nPast;
+            if (!decodeRange(session->nPast, session->history.size())) {
+                session->history.resize(session->history.size() - tokens.size());
+                sessionRegistry.release(session.get());
+                SetError("Failed to process message");
+                return;
+            }
+            logger.log("Session " + std::to_string(session->id) + ": prefilled " +
+                       std::to_string(prefilled) + " tokens, " +
+                       std::to_string(session->nPast) + " resident");
+        }
+
+        // The last sampled token is kept in history without being decoded;
+        // the next turn's prefill picks it up
+        StopStream stopFilter(stop);
+        for (int i = 0; i < maxTokens; i++) {
+            llama_token token;
+            {
+                TraceSpan span("sample", traceTrack);
+                token = sampleGreedy(vocab);
+            }
+            session->history.push_back(token);
+            if (llama_vocab_is_eog(vocab, token)) break;
+
+            {
+                TraceSpan span("detokenize", traceTrack);
+                result += stopFilter.push(tokenToPiece(vocab, token));
+            }
+            if (stopFilter.stopped()) break;
+            if (i + 1 == maxTokens || session->nPast + 1 >= (size_t)session->contextSize) break;
+
+            TraceSpan span("decode", traceTrack);
+            if (!decodeRange(session->nPast, session->nPast + 1)) {
+                logger.log("ERROR: Failed to decode token " + std::to_string(i));
+                break;
+            }
+        }
+        result += stopFilter.flush();
+        logger.log("Session " + std::to_string(session->id) + ": generated " +
+                   std::to_string(result.length()) + " characters");
+    }
+
+    void OnOK() override {
+        Napi::HandleScope scope(Env());
+        Callback().Call({Env().Null(), Napi::String::New(Env(), result)});
+    }
+
+    void OnError(const Napi::Error& e) override {
+        Napi::HandleScope scope(Env());
+        logger.log("Session turn failed: " + std::string(e.Message()));
+        Callback().Call({Napi::String::New(Env(), e.Message()), Env().Null()});
+    }
+
+private:
+    static const int BATCH_SIZE = 512;
+
+    // Decodes history[from, to) in batches, advancing nPast; logits are only
+    // computed for the last token
+    bool decodeRange(size_t from, size_t to) {
+        llama_batch batch = llama_batch_init(BATCH_SIZE, 0, 1);
+        bool ok = true;
+        for (size_t start = from; start < to && ok; start += BATCH_SIZE) {
+            size_t n = std::min<size_t>(BATCH_SIZE, to - start);
+            for (size_t i = 0; i < n; i++) {
+                batch.token[i] = session->history[start + i];
+                batch.pos[i] = start + i;
+                batch.n_seq_id[i] = 1;
+                batch.seq_id[i][0] = 0;
+                batch.logits[i] = (start + i == to - 1) ? 1 : 0;
+            }
+            batch.n_tokens = n;
+            ok = llama_decode(session->ctx, batch) == 0;
+            if (ok) session->nPast = start + n;
+        }
+        llama_batch_free(batch);
+        return ok;
+    }
+
+    llama_token sampleGreedy(const llama_vocab* vocab) {
+        const float* logits = llama_get_logits_ith(session->ctx, -1);
+        int vocab_size = llama_vocab_n_tokens(vocab);
+        return (llama_token)(std::max_element(logits, logits + vocab_size) - logits);
+    }
+
+    static std::string tokenToPiece(const llama_vocab* vocab, llama_token token) {
+        std::string piece(64, '\0');
+        int n = llama_token_to_piece(vocab, token, &piece[0], piece.size(), 0, true);
+        if (n < 0) {
+            piece.resize(-n);
+            n = llama_token_to_piece(vocab, token, &piece[0], piece.size(), 0, true);
+        }
+        piece.resize(std::max(n, 0));
+        return piece;
+    }
+
+    std::shared_ptr<ChatSession> session;
+    std::string text;
+    int maxTokens;
+    std::vector<std::string> stop;
+    std::string result;
+    uint64_t traceTrack;
+};
+
+// createSession(modelPath, [options]) -> sessionId
+// options: { contextSize, maxTokens, stop } are the session's defaults.
+// The model is loaded by the first appendAndGenerate, not here.
+Napi::Value CreateSession(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || info.Length() > 2 || !info[0].IsString() ||
+        (info.Length() == 2 && !info[1].IsObject())) {
+        Napi::TypeError::New(env, "Expected arguments: modelPath (string), [options (object)]").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string modelPath = info[0].As<Napi::String>().Utf8Value();
+    int contextSize = 2048;
+    int maxTokens = 128;
+    std::vector<std::string> stop;
+    if (info.Length() == 2) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        contextSize = readInt(options, "contextSize", contextSize);
+        maxTokens = readInt(options, "maxTokens", maxTokens);
+        readStringArray(options, "stop", stop);
+    }
+
+    uint32_t id = sessionRegistry.create(modelPath, contextSize, maxTokens, std::move(stop));
+    logger.log("Created session " + std::to_string(id) + " for model: " + modelPath);
+    return Napi::Number::New(env, id);
+}
+
+// appendAndGenerate(sessionId, text, [options], callback(err, generatedText))
+// options: { maxTokens, stop } override the session defaults for this turn.
+Napi::Value AppendAndGenerate(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    size_t cbIndex = info.Length() - 1;
+    if (info.Length() < 3 || info.Length() > 4 || !info[0].IsNumber() || !info[1].IsString() ||
+        !info[cbIndex].IsFunction() || (info.Length() == 4 && !info[2].IsObject())) {
+        Napi::TypeError::New(env, "Expected arguments: sessionId (number), text (string), [options (object)], callback (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+    std::shared_ptr<ChatSession> session = sessionRegistry.get(id);
+    if (!session) {
+        Napi::Error::New(env, "Unknown session: " + std::to_string(id)).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string text = info[1].As<Napi::String>().Utf8Value();
+    Napi::Function callback = info[cbIndex].As<Napi::Function>();
+    int maxTokens = session->maxTokens;
+    std::vector<std::string> stop = session->stop;
+    if (info.Length() == 4) {
+        Napi::Object options = info[2].As<Napi::Object>();
+        maxTokens = readInt(options, "maxTokens", maxTokens);
+        if (options.Has("stop")) {
+            stop.clear();
+            readStringArray(options, "stop", stop);
+        }
+    }
+
+    SessionWorker* worker = new SessionWorker(callback, std::move(session), std::move(text), maxTokens, std::move(stop));
+    worker->Queue();
+    return env.Undefined();
+}
+
+// disposeSession(sessionId) -> true if the session existed
+Napi::Value DisposeSession(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: sessionId (number)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+    bool existed = sessionRegistry.dispose(id);
+    logger.log("Disposed session " + std::to_string(id) + (existed ? "" : " (unknown)"));
+    return Napi::Boolean::New(env, existed);
+}
+
+// setSessionLimit(n): how many sessions may keep a context resident
+Napi::Value SetSessionLimit(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: limit (number)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    sessionRegistry.setMaxResident(std::max(1, info[0].As<Napi::Number>().Int32Value()));
+    return env.Undefined();
+}
+
 Napi::Value GetWorkerLog(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     logger.log("GetWorkerLog function called");
@@ -342,10 +898,38 @@ Napi::Value GetWorkerLog(const Napi::CallbackInfo& info) {
     return Napi::String::New(env, content);
 }
 
+Napi::Value SetTraceEnabled(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsBoolean()) {
+        Napi::TypeError::New(env, "Expected arguments: enabled (boolean)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    bool enabled = info[0].As<Napi::Boolean>().Value();
+    tracer.setEnabled(enabled);
+    logger.log(std::string("Tracing ") + (enabled ? "enabled" : "disabled"));
+    return env.Undefined();
+}
+
+// Returns the trace ring as Chrome/Perfetto trace-event JSON and clears it
+Napi::Value GetTrace(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::string json = tracer.toJson();
+    tracer.clear();
+    return Napi::String::New(env, json);
+}
+
 Napi::Object InitModule(Napi::Env env, Napi::Object exports) {
     logger.log("Initializing llama_addon module");
     exports.Set("processPrompt", Napi::Function::New(env, ProcessPrompt));
     exports.Set("getWorkerLog", Napi::Function::New(env, GetWorkerLog));
+    exports.Set("setTraceEnabled", Napi::Function::New(env, SetTraceEnabled));
+    exports.Set("getTrace", Napi::Function::New(env, GetTrace));
+    exports.Set("createSession", Napi::Function::New(env, CreateSession));
+    exports.Set("appendAndGenerate", Napi::Function::New(env, AppendAndGenerate));
+    exports.Set("disposeSession", Napi::Function::New(env, DisposeSession));
+    exports.Set("setSessionLimit", Napi::Function::New(env, SetSessionLimit));
     return exports;
 }
 
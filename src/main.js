@@ -61,6 +61,24 @@ app.on('window-all-closed', function () {
   }
 });
 
+// Resolve a model path from the renderer and check the file exists
+function resolveModelPath(modelPath) {
+  // If modelPath is relative, make it absolute based on app resources
+  if (!path.isAbsolute(modelPath)) {
+    const absolutePath = path.join(app.getAppPath(), '..', 'models', modelPath);
+    console.log(`[Main Process] Converting relative path to absolute: ${absolutePath}`);
+    modelPath = absolutePath;
+  }
+
+  // Check if model file exists
+  if (!fs.existsSync(modelPath)) {
+    console.error(`[Main Process] Error: Model file not found at ${modelPath}`);
+    throw new Error(`Model file not found: ${modelPath}`);
+  }
+
+  return modelPath;
+}
+
 // Handle prompt processing request from renderer
 ipcMain.handle('process-prompt', async (event, modelPath, prompt) => {
   console.log(`[Main Process] Processing prompt request received:
@@ -68,18 +86,7 @@ ipcMain.handle('process-prompt', async (event, modelPath, prompt) => {
   - Prompt: "${prompt.substring(0, 50)}${prompt.length > 50 ? '...' : ''}"`);
   
   try {
-    // If modelPath is relative, make it absolute based on app resources
-    if (!path.isAbsolute(modelPath)) {
-      const absolutePath = path.join(app.getAppPath(), '..', 'models', modelPath);
-      console.log(`[Main Process] Converting relative path to absolute: ${absolutePath}`);
-      modelPath = absolutePath;
-    }
-
-    // Check if model file exists
-    if (!fs.existsSync(modelPath)) {
-      console.error(`[Main Process] Error: Model file not found at ${modelPath}`);
-      throw new Error(`Model file not found: ${modelPath}`);
-    }
+    modelPath = resolveModelPath(modelPath);
     
     console.log(`[Main Process] Model file exists, sending to addon for processing`);
 
@@ -104,6 +111,57 @@ ipcMain.handle('process-prompt', async (event, modelPath, prompt) => {
   }
 });
 
+// Chat sessions keep the conversation resident in the addon, so each turn
+// only sends (and prefills) the new message and returns only the reply.
+ipcMain.handle('create-session', async (event, modelPath, options) => {
+  console.log(`[Main Process] Create session requested for model: ${modelPath}`);
+
+  try {
+    modelPath = resolveModelPath(modelPath);
+    const sessionId = llamaAddon.createSession(modelPath, options || {});
+    console.log(`[Main Process] Created session ${sessionId}`);
+    return sessionId;
+  } catch (error) {
+    console.error('[Main Process] Error creating session:', error);
+    throw error;
+  }
+});
+
+ipcMain.handle('append-and-generate', async (event, sessionId, text, options) => {
+  console.log(`[Main Process] Session ${sessionId} turn received:
+  - Text: "${text.substring(0, 50)}${text.length > 50 ? '...' : ''}"`);
+
+  try {
+    const result = await new Promise((resolve, reject) => {
+      llamaAddon.appendAndGenerate(sessionId, text, options || {}, (err, result) => {
+        if (err) {
+          console.error('[Main Process] Addon session error:', err);
+          reject(err);
+        } else {
+          resolve(result);
+        }
+      });
+    });
+
+    console.log(`[Main Process] Session ${sessionId} turn completed`);
+    return result;
+  } catch (error) {
+    console.error('[Main Process] Error generating session turn:', error);
+    throw error;
+  }
+});
+
+ipcMain.handle('dispose-session', async (event, sessionId) => {
+  console.log(`[Main Process] Dispose session ${sessionId} requested`);
+
+  try {
+    return llamaAddon.disposeSession(sessionId);
+  } catch (error) {
+    console.error('[Main Process] Error disposing session:', error);
+    throw error;
+  }
+});
+
 // Handle worker log request from renderer
 ipcMain.handle('get-worker-log', async (event) => {
   console.log('[Main Process] Worker log requested');
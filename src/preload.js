@@ -10,5 +10,14 @@ contextBridge.exposeInMainWorld('llamaAPI', {
   },
   getWorkerLog: () => {
     return ipcRenderer.invoke('get-worker-log');
+  },
+  createSession: (modelPath, options) => {
+    return ipcRenderer.invoke('create-session', modelPath, options);
+  },
+  appendAndGenerate: (sessionId, text, options) => {
+    return ipcRenderer.invoke('append-and-generate', sessionId, text, options);
+  },
+  disposeSession: (sessionId) => {
+    return ipcRenderer.invoke('dispose-session', sessionId);
   }
 }); 
\ No newline at end of file
@@ -2,9 +2,19 @@
 
 // Mock for the llama_addon native Node.js addon.
 // Returns Jest mock functions so tests can assert on and control
-// processPrompt / getWorkerLog behaviour without a compiled .node binary.
+// processPrompt / getWorkerLog / chat session behaviour without a compiled
+// .node binary.
 
 const processPrompt = jest.fn();
 const getWorkerLog = jest.fn();
+const createSession = jest.fn();
+const appendAndGenerate = jest.fn();
+const disposeSession = jest.fn();
 
-module.exports = { processPrompt, getWorkerLog };
+module.exports = {
+  processPrompt,
+  getWorkerLog,
+  createSession,
+  appendAndGenerate,
+  disposeSession,
+};
@@ -29,6 +29,9 @@ const addonMock = require('../../src/addon/build/Release/llama_addon.node');
 // We load it once after all mocks are in place.
 let mockProcessPrompt;
 let mockGetWorkerLog;
+let mockCreateSession;
+let mockAppendAndGenerate;
+let mockDisposeSession;
 
 beforeAll(() => {
   // Provide a stubbed fs.existsSync so file checks work predictably.
@@ -39,6 +42,9 @@ beforeAll(() => {
   // Grab references to the mock functions from the mapped module
   mockProcessPrompt = addonMock.processPrompt;
   mockGetWorkerLog = addonMock.getWorkerLog;
+  mockCreateSession = addonMock.createSession;
+  mockAppendAndGenerate = addonMock.appendAndGenerate;
+  mockDisposeSession = addonMock.disposeSession;
 });
 
 afterEach(() => {
@@ -155,6 +161,102 @@ describe('ipcMain handler: get-worker-log', () => {
   });
 });
 
+// ── chat session handlers ────────────────────────────────────────────────────
+
+describe('ipcMain handler: create-session', () => {
+  test('returns the session id from the addon for an absolute model path', async () => {
+    mockCreateSession.mockReturnValue(3);
+    const options = { contextSize: 4096, stop: ['User:'] };
+
+    const result = await invokeHandler('create-session', '/models/chat.gguf', options);
+
+    expect(result).toBe(3);
+    expect(mockCreateSession).toHaveBeenCalledWith('/models/chat.gguf', options);
+  });
+
+  test('resolves a relative model path and defaults options to {}', async () => {
+    mockCreateSession.mockReturnValue(1);
+    app.getAppPath.mockReturnValue('/app/root');
+
+    await invokeHandler('create-session', 'chat.gguf');
+
+    const expectedAbsPath = path.join('/app/root', '..', 'models', 'chat.gguf');
+    expect(mockCreateSession).toHaveBeenCalledWith(expectedAbsPath, {});
+  });
+
+  test('throws when the model file does not exist', async () => {
+    fs.existsSync.mockReturnValue(false);
+
+    await expect(invokeHandler('create-session', '/missing.gguf')).rejects.toThrow(
+      /Model file not found/
+    );
+    expect(mockCreateSession).not.toHaveBeenCalled();
+  });
+});
+
+describe('ipcMain handler: append-and-generate', () => {
+  test('resolves with only the generated reply', async () => {
+    mockAppendAndGenerate.mockImplementation((_id, _t, _o, cb) => cb(null, 'reply'));
+
+    const result = await invokeHandler('append-and-generate', 3, 'next turn', { maxTokens: 32 });
+
+    expect(result).toBe('reply');
+    expect(mockAppendAndGenerate).toHaveBeenCalledWith(
+      3,
+      'next turn',
+      { maxTokens: 32 },
+      expect.any(Function)
+    );
+  });
+
+  test('defaults options to {}', async () => {
+    mockAppendAndGenerate.mockImplementation((_id, _t, _o, cb) => cb(null, ''));
+
+    await invokeHandler('append-and-generate', 3, 'hi');
+
+    expect(mockAppendAndGenerate).toHaveBeenCalledWith(3, 'hi', {}, expect.any(Function));
+  });
+
+  test('throws when the addon callback returns an error', async () => {
+    mockAppendAndGenerate.mockImplementation((_id, _t, _o, cb) =>
+      cb(new Error('Conversation no longer fits in the session context'), null)
+    );
+
+    await expect(invokeHandler('append-and-generate', 3, 'hi')).rejects.toThrow(
+      'Conversation no longer fits'
+    );
+  });
+
+  test('throws when the addon rejects an unknown session synchronously', async () => {
+    mockAppendAndGenerate.mockImplementation(() => {
+      throw new Error('Unknown session: 99');
+    });
+
+    await expect(invokeHandler('append-and-generate', 99, 'hi')).rejects.toThrow(
+      'Unknown session: 99'
+    );
+  });
+});
+
+describe('ipcMain handler: dispose-session', () => {
+  test('returns whether the addon knew the session', async () => {
+    mockDisposeSession.mockReturnValue(true);
+
+    const result = await invokeHandler('dispose-session', 3);
+
+    expect(result).toBe(true);
+    expect(mockDisposeSession).toHaveBeenCalledWith(3);
+  });
+
+  test('throws when the addon disposeSession throws', async () => {
+    mockDisposeSession.mockImplementation(() => {
+      throw new Error('bad id');
+    });
+
+    await expect(invokeHandler('dispose-session', 'x')).rejects.toThrow('bad id');
+  });
+});
+
 // ── select-model handler ─────────────────────────────────────────────────────
 
 describe('ipcMain handler: select-model', () => {
@@ -37,9 +37,16 @@ describe('preload.js — contextBridge setup', () => {
     expect(exposedName).toBe('llamaAPI');
   });
 
-  test('exposes exactly three methods: processPrompt, selectModel, getWorkerLog', () => {
+  test('exposes the prompt, model, log and chat session methods', () => {
     const keys = Object.keys(exposedApi).sort();
-    expect(keys).toEqual(['getWorkerLog', 'processPrompt', 'selectModel']);
+    expect(keys).toEqual([
+      'appendAndGenerate',
+      'createSession',
+      'disposeSession',
+      'getWorkerLog',
+      'processPrompt',
+      'selectModel',
+    ]);
   });
 
   test('all exposed properties are functions', () => {
@@ -111,6 +118,35 @@ describe('preload.js — ipcRenderer delegation', () => {
     expect(result).toBe('log line 1\nlog line 2\n');
   });
 
+  test('createSession invokes "create-session" channel with modelPath and options', async () => {
+    ipcRenderer.invoke.mockResolvedValue(7);
+    const options = { contextSize: 4096 };
+
+    const result = await exposedApi.createSession('/path/to/model.gguf', options);
+
+    expect(ipcRenderer.invoke).toHaveBeenCalledWith('create-session', '/path/to/model.gguf', options);
+    expect(result).toBe(7);
+  });
+
+  test('appendAndGenerate invokes "append-and-generate" channel with session, text and options', async () => {
+    ipcRenderer.invoke.mockResolvedValue('reply');
+    const options = { maxTokens: 64 };
+
+    const result = await exposedApi.appendAndGenerate(7, 'next turn', options);
+
+    expect(ipcRenderer.invoke).toHaveBeenCalledWith('append-and-generate', 7, 'next turn', options);
+    expect(result).toBe('reply');
+  });
+
+  test('disposeSession invokes "dispose-session" channel with the session id', async () => {
+    ipcRenderer.invoke.mockResolvedValue(true);
+
+    const result = await exposedApi.disposeSession(7);
+
+    expect(ipcRenderer.invoke).toHaveBeenCalledWith('dispose-session', 7);
+    expect(result).toBe(true);
+  });
+
   test('each API method propagates rejection from ipcRenderer.invoke', async () => {
     const error = new Error('IPC failure');
     ipcRenderer.invoke.mockRejectedValue(error);
@@ -120,5 +156,11 @@ describe('preload.js — ipcRenderer delegation', () => {
     await expect(exposedApi.selectModel()).rejects.toThrow('IPC failure');
     ipcRenderer.invoke.mockRejectedValue(error);
     await expect(exposedApi.getWorkerLog()).rejects.toThrow('IPC failure');
+    ipcRenderer.invoke.mockRejectedValue(error);
+    await expect(exposedApi.createSession('/m')).rejects.toThrow('IPC failure');
+    ipcRenderer.invoke.mockRejectedValue(error);
+    await expect(exposedApi.appendAndGenerate(1, 't')).rejects.toThrow('IPC failure');
+    ipcRenderer.invoke.mockRejectedValue(error);
+    await expect(exposedApi.disposeSession(1)).rejects.toThrow('IPC failure');
   });
 });